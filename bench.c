@@ -0,0 +1,378 @@
+// OS Assignment - dice game - bench.c (ROLL -> ROLLED round trip over every transport the server supports)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include "game.h"
+
+#define BP 5 // BP = most concurrent client/handler pairs
+#define BN 100000 // BN = default round trips per pair
+#define bench_out "bench_results.csv"
+#define bench_p "/tmp/dice_bench_" // bench_p = FIFO prefix, followed by <pair>_to_server / _from_server
+
+// Transports, the same three the server can be started with
+#define TR_FIFO 0
+#define TR_SOCKET 1
+#define TR_MAILBOX 2
+
+// One client/handler pair, lives in shared memory so every forked process sees it
+struct Pair
+{
+    struct Mailbox to_server;
+    struct Mailbox from_server;
+};
+
+// Shared between the parent and all forked processes of one run
+struct Run
+{
+    unsigned int go; // go = futex word, clients start together once it turns 1
+    int done; // clients finished
+    struct Pair pair[BP];
+};
+
+struct Run *run = NULL;
+long long *lat = NULL; // lat = round trip of every message, pair p owns lat[p * rounds ...]
+int rounds = BN;
+
+const char *tn[] = { "fifo", "socket", "mailbox" }; // tn = transport names
+
+// Function declarations
+void bh(int transport, int p, int fd_read, int fd_write); // bh = bench handler, answers like hd()
+void bc(int transport, int p, int fd_write, int fd_read); // bc = bench client, rolls like play()
+int br(int transport, int pairs, FILE *out); // br = bench run, one transport at one concurrency
+int lc(const void *a, const void *b); // lc = latency compare for qsort
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2)
+    {
+        printf("Usage: %s [rounds per pair]\n", argv[0]);
+        return 1;
+    }
+
+    if (argc == 2)
+    {
+        rounds = atoi(argv[1]);
+        if (rounds < 1)
+        {
+            fprintf(stderr, "Rounds must be at least 1\n");
+            return 1;
+        }
+    }
+
+    run = mmap(NULL, sizeof(struct Run), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    lat = mmap(NULL, (size_t)BP * rounds * sizeof(long long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (run == MAP_FAILED || lat == MAP_FAILED)
+    {
+        perror("Memory mapping failed");
+        return 1;
+    }
+
+    FILE *out;
+    out = fopen(bench_out, "w");
+    if (out == NULL)
+    {
+        perror("Cannot write " bench_out);
+        return 1;
+    }
+    fprintf(out, "transport,pairs,messages,p50_ns,p99_ns,p999_ns,max_ns,msgs_per_sec\n");
+
+    printf("ROLL -> ROLLED round trip, %d rounds per pair, %d byte frames\n\n", rounds, (int)sizeof(struct Frame));
+    printf("%-8s %5s %10s %10s %10s %10s %12s\n", "", "pairs", "p50 ns", "p99 ns", "p999 ns", "max ns", "msgs/sec");
+
+    int transport;
+    for (transport = TR_FIFO; transport <= TR_MAILBOX; transport = transport + 1)
+    {
+        if (br(transport, 1, out) == -1 || br(transport, BP, out) == -1)
+        {
+            fclose(out);
+            return 1;
+        }
+    }
+
+    fclose(out);
+    printf("\nResults written to %s\n", bench_out);
+    return 0;
+}
+
+int lc(const void *a, const void *b)
+{
+    long long x;
+    long long y;
+    x = *(const long long *)a;
+    y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+int br(int transport, int pairs, FILE *out)
+{
+    memset(run, 0, sizeof(struct Run));
+
+    // children exit() through stdio, flush first or they write our buffered lines a second time
+    fflush(stdout);
+    fflush(out);
+
+    pid_t pids[BP * 2];
+    int count;
+    count = 0;
+
+    int p;
+    for (p = 0; p < pairs; p = p + 1)
+    {
+        // c_* = client side, h_* = handler side of this pair
+        int c_write;
+        int c_read;
+        int h_read;
+        int h_write;
+        c_write = -1;
+        c_read = -1;
+        h_read = -1;
+        h_write = -1;
+
+        char to_path[64];
+        char from_path[64];
+        snprintf(to_path, sizeof(to_path), "%s%d_to_server", bench_p, p);
+        snprintf(from_path, sizeof(from_path), "%s%d_from_server", bench_p, p);
+
+        if (transport == TR_FIFO)
+        {
+            unlink(to_path);
+            unlink(from_path);
+            if (mkfifo(to_path, 0666) == -1 || mkfifo(from_path, 0666) == -1)
+            {
+                perror("FIFO creation failed");
+                return -1;
+            }
+        }
+        else if (transport == TR_SOCKET)
+        {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) == -1)
+            {
+                perror("Socket pair creation failed");
+                return -1;
+            }
+            c_write = sv[0];
+            c_read = sv[0];
+            h_read = sv[1];
+            h_write = sv[1];
+        }
+
+        pid_t handler_pid;
+        handler_pid = fork();
+        if (handler_pid == 0)
+        {
+            if (transport == TR_FIFO)
+            {
+                // opening order matches the client below, otherwise both sides block forever
+                h_read = open(to_path, O_RDONLY);
+                h_write = open(from_path, O_WRONLY);
+            }
+            if (c_write != -1)
+            {
+                close(c_write);
+            }
+            bh(transport, p, h_read, h_write);
+            exit(0);
+        }
+        pids[count] = handler_pid;
+        count = count + 1;
+
+        pid_t client_pid;
+        client_pid = fork();
+        if (client_pid == 0)
+        {
+            if (transport == TR_FIFO)
+            {
+                c_write = open(to_path, O_WRONLY);
+                c_read = open(from_path, O_RDONLY);
+            }
+            if (h_read != -1)
+            {
+                close(h_read);
+            }
+            bc(transport, p, c_write, c_read);
+            exit(0);
+        }
+        pids[count] = client_pid;
+        count = count + 1;
+
+        if (c_write != -1)
+        {
+            close(c_write);
+            close(h_read);
+        }
+    }
+
+    // give every process time to open its end, then start all clients at once
+    usleep(100000);
+    long long started;
+    started = mn();
+    __atomic_store_n(&run->go, 1, __ATOMIC_RELEASE);
+    fwk(&run->go, INT_MAX);
+
+    int i;
+    for (i = 0; i < count; i = i + 1)
+    {
+        waitpid(pids[i], NULL, 0);
+    }
+
+    long long elapsed;
+    elapsed = mn() - started;
+
+    if (transport == TR_FIFO)
+    {
+        for (p = 0; p < pairs; p = p + 1)
+        {
+            char fifo_path[64];
+            snprintf(fifo_path, sizeof(fifo_path), "%s%d_to_server", bench_p, p);
+            unlink(fifo_path);
+            snprintf(fifo_path, sizeof(fifo_path), "%s%d_from_server", bench_p, p);
+            unlink(fifo_path);
+        }
+    }
+
+    if (run->done != pairs)
+    {
+        fprintf(stderr, "%s with %d pair(s): only %d client(s) finished\n", tn[transport], pairs, run->done);
+        return -1;
+    }
+
+    long long total;
+    total = (long long)pairs * rounds;
+    qsort(lat, total, sizeof(long long), lc);
+
+    long long p50;
+    long long p99;
+    long long p999;
+    long long max;
+    p50 = lat[total * 50 / 100];
+    p99 = lat[total * 99 / 100];
+    p999 = lat[total * 999 / 1000];
+    max = lat[total - 1];
+
+    double rate;
+    rate = (double)total * 1000000000.0 / (double)elapsed;
+
+    printf("%-8s %5d %10lld %10lld %10lld %10lld %12.0f\n", tn[transport], pairs, p50, p99, p999, max, rate);
+    fprintf(out, "%s,%d,%lld,%lld,%lld,%lld,%lld,%.0f\n", tn[transport], pairs, total, p50, p99, p999, max, rate);
+    return 0;
+}
+
+// answer every ROLL with a ROLLED carrying its seq, the same work hd() does minus the game rules
+void bh(int transport, int p, int fd_read, int fd_write)
+{
+    struct FrameIn in;
+    in.len = 0;
+
+    struct Frame request;
+    struct Frame reply;
+
+    int answered;
+    answered = 0;
+
+    while (answered < rounds)
+    {
+        if (transport == TR_MAILBOX)
+        {
+            if (mr(&run->pair[p].to_server, &request, NULL) == 0)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            if (fx(&in, &request) == 0)
+            {
+                struct pollfd pfd;
+                pfd.fd = fd_read;
+                pfd.events = POLLIN;
+                poll(&pfd, 1, -1);
+
+                if (fi(fd_read, &in) <= 0)
+                {
+                    return;
+                }
+                continue;
+            }
+        }
+
+        reply.type = MT_ROLLED;
+        reply.player = p;
+        reply.seq = request.seq;
+        reply.payload = (answered % 6) + 1;
+        reply.ts = mn();
+
+        if (transport == TR_MAILBOX)
+        {
+            ms(&run->pair[p].from_server, &reply);
+        }
+        else
+        {
+            fo(fd_write, &reply, 1);
+        }
+        answered = answered + 1;
+    }
+}
+
+// one ROLL at a time and wait for its answer, like rq() in the client
+void bc(int transport, int p, int fd_write, int fd_read)
+{
+    while (__atomic_load_n(&run->go, __ATOMIC_ACQUIRE) == 0)
+    {
+        fw(&run->go, 0, NULL);
+    }
+
+    struct FrameIn in;
+    in.len = 0;
+
+    struct Frame request;
+    struct Frame reply;
+
+    int r;
+    for (r = 0; r < rounds; r = r + 1)
+    {
+        request.type = MT_ROLL;
+        request.player = p;
+        request.seq = r;
+        request.payload = 0;
+        request.ts = mn();
+
+        if (transport == TR_MAILBOX)
+        {
+            ms(&run->pair[p].to_server, &request);
+            while (mr(&run->pair[p].from_server, &reply, NULL) == 0)
+            {
+            }
+        }
+        else
+        {
+            fo(fd_write, &request, 1);
+            while (fx(&in, &reply) == 0)
+            {
+                struct pollfd pfd;
+                pfd.fd = fd_read;
+                pfd.events = POLLIN;
+                poll(&pfd, 1, -1);
+
+                if (fi(fd_read, &in) <= 0)
+                {
+                    return;
+                }
+            }
+        }
+
+        lat[(long long)p * rounds + r] = mn() - request.ts;
+    }
+
+    __atomic_add_fetch(&run->done, 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# OS Assignment - dice game - bots.sh (start N headless clients against a running server)
+# Usage: ./bots.sh N [think ms] [table]
+# Every bot goes through the lobby unless a table is given, each prints its roll latencies when it leaves
+
+if [ $# -lt 1 ] || [ $# -gt 3 ]
+then
+    echo "Usage: $0 N [think ms] [table]"
+    exit 1
+fi
+
+count=$1
+think=${2:-0}
+table=$3
+
+pids=""
+i=1
+while [ "$i" -le "$count" ]
+do
+    ./client --bot --think "$think" "B$i" $table &
+    pids="$pids $!"
+    i=$((i + 1))
+done
+
+# Ctrl+C stops the bots too, each one still prints its stats on the way out
+trap 'kill $pids 2>/dev/null' INT TERM
+wait
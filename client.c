@@ -11,41 +11,147 @@
 #include <errno.h>
 #include <time.h>
 #include <sys/select.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <stdarg.h>
+#include "game.h"
 
-// setting: min 3 players, and max 5 players, the first player race to R20 will be the winner, each player uses unique FIFO path
-#define MXP 5 // mxp = maximum 5 player
-#define WC 20 // wc= win condition
-#define fifo_p "/tmp/player_" // fifo_p = fifo prefox 
+// setting: seats, minimum players and the winning row come from the server, see ShmHeader
+#define BS 65536 // BS = roll latencies a bot keeps for its percentiles
+#define WI 100 // WI = ms a spectator sleeps between two looks at the board, the same pace a player's screen is redrawn at
 
-// Game state structure
-struct GameInfo 
+struct ShmHeader *shm = NULL; // shm = whole mapped segment
+size_t shm_len = 0;
+struct GameInfo *gptr = NULL; // gptr = game pointer of the table we sit at
+int my_table = -1;
+int my_player_id = -1;
+int my_games = 0; // my_games = games counter of our table when we sat down
+unsigned short my_seq = 0; // my_seq = seq of the last frame we sent
+int sock_fd = -1; // sock_fd = connection to a --socket server, carries frames both ways
+char my_name[7];
+struct View view; // view = last consistent copy of our table, sized by vn() once we know the seats
+unsigned int drawn_gen = 1; // drawn_gen = view.gen the screen currently shows
+char drawn_action[256]; // texts the screen currently shows, sg() skips a redraw that would change nothing
+char drawn_status[256];
+unsigned int ev_at = 0; // ev_at = next event of our table we have not read
+int ev_ok = 0; // ev_ok = ev_at belongs to the seat we hold now
+
+// One frame of the board as text, kept so the next frame only sends what changed
+struct Screen
 {
-    int PP[MXP]; //PP = player position 
-    int CT; // CT = current turn
-    int game_active;
-    int CP; // CP = connected player 
-    int player_active[MXP];
-    int FW; // FW = final winner 
-    int round;
-    char PN[MXP][50]; //PN = player name
-    int TWN[MXP]; //TWN = total winning
-    pthread_mutex_t shm_lock;
-    pthread_mutex_t table_sync;
-    int mnpr; // mnpr = min player require
+    char *text; // text = the lines of the frame back to back, each ending in a newline
+    size_t len;
+    size_t cap;
+    size_t *at; // at = where each line starts in text, at[lines] is the end
+    int lines;
+    int line_cap;
+    int width; // width = longest line
 };
 
-struct GameInfo *gptr = NULL; // gptr = game pointer
-int my_player_id = -1;
-char my_name[7];
+struct Screen scr_now; // scr_now = frame sg() is building
+struct Screen scr_was; // scr_was = frame the terminal shows
+struct Screen scr_out; // scr_out = bytes of the next write(), only text and len are used
+int scr_valid = 0; // scr_valid = the terminal really shows scr_was, 0 after anything else printed
+int typed_seen = 0; // typed_seen = bytes waiting on stdin at the last frame, more means the terminal echoed keys since
+int bot_mode = 0; // --bot, roll automatically and draw nothing
+int watch_mode = 0; // --watch, spectate a table read only, no seat, no lock, no FIFO
+int think_ms = 0; // think_ms = pause before each bot roll
+long long bot_lat[BS]; // bot_lat = ROLL -> ROLLED round trip of each bot turn in ns
+int bot_turns = 0; // turns played, may exceed BS
+int bot_missed = 0; // rolls the server never answered
+long long bot_sum = 0;
+long long bot_max = 0;
+volatile sig_atomic_t bot_stop = 0; // bot_stop = SIGINT or SIGTERM arrived, leave and print the stats
 
 // Function declarations
 void ssm(); // ssm = setting share memeory 
 void Cfifo(); // Cfifo = create fifo 
 void sg(const char *last_action, const char *current_status); // sg = show grid 
+void hl(int cols); // hl = horizontal line under one board row
+void sn(struct Screen *s, const char *bytes, size_t n); // sn = screen append n bytes
+void sw(struct Screen *s, const char *format, ...); // sw = screen write, printf into a frame
+void si(struct Screen *s); // si = screen index, find the lines of a frame
+void sd(); // sd = screen diff, send the frame in scr_now
+int ed(char *text, size_t n); // ed = event drain, what other players did up to the current snapshot
 void play();
 void cr(); // cr = clean resourcws 
+void rs(); // rs = release seat, FIFOs and slot claim
+int og(int picked); // og = one game, from taking a seat to the results
+int ag(int picked); // ag = again, ask to stay for the next game in continuous mode
 int Fslot(); // Fslot = find available slot 
+int Ftable(); // Ftable = claim a slot at the table given on the command line
+int lq(); // lq = lobby queue, let the server pick the table
+int jw(struct JoinMsg *msg); // jw = join write
+int nj(); // nj = notify join 
+int sc(); // sc = socket connect, joins a --socket server
+int rq(int fd_write, int fd_read, struct FrameIn *in); // rq = roll request
+void rl(const struct Frame *request, const struct Frame *reply); // rl = roll latency, into the server histograms
 int winput(); // winput = waiting for input 
+int wt(); // wt = watch table, spectator loop of --watch
+void bt(long long latency, int dice_value); // bt = bot tally, record one bot turn
+void bs(); // bs = bot stats, printed when a bot leaves
+int lc(const void *a, const void *b); // lc = latency compare for qsort
+void bot_signal(int sig);
+
+// follow a table from snapshots and its event ring until the server stops
+// polls gen every WI ms instead of sleeping on state_ftx, so the players' wake-ups never have to reach us
+int wt()
+{
+    gptr = tp(shm, my_table);
+
+    // drawing is all a spectator does, the lowest priority lets any player process run before it
+    nice(19);
+
+    char last_action[256];
+    last_action[0] = '\0';
+    char status[256];
+
+    printf("Watching table %d, Ctrl+C to stop\n", my_table);
+
+    int stopping;
+    stopping = 0;
+
+    while (bot_stop == 0 && stopping == 0)
+    {
+        // read before the board, so the last look still shows how the game ended
+        stopping = shm->stopping;
+
+        // an unchanged board costs one load
+        if (gs(gptr, &view) == 1)
+        {
+            ed(last_action, sizeof(last_action));
+
+            if (view.game_active == 1)
+            {
+                snprintf(status, sizeof(status), "Round %d - %s's turn", view.round, view.PN[view.CT]);
+            }
+            else if (view.FW >= 0)
+            {
+                snprintf(status, sizeof(status), "GAME OVER! Winner: %s", view.PN[view.FW]);
+            }
+            else
+            {
+                snprintf(status, sizeof(status), "Waiting for players... %d/%d connected (minimum)",
+                         view.CP, gptr->mnpr);
+            }
+            sg(last_action, status);
+        }
+
+        if (stopping == 0)
+        {
+            usleep(WI * 1000);
+        }
+    }
+
+    if (stopping == 1)
+    {
+        printf("\nServer is shutting down, stopped watching\n");
+    }
+    return 0;
+}
 
 // waiting for user input with timeout 
 int winput() 
@@ -65,6 +171,8 @@ int winput()
     if (result > 0) 
     {
         getchar();
+        typed_seen = 0; // the line is in stdio's buffer now, its echo is already on screen
+        ioctl(STDIN_FILENO, FIONREAD, &typed_seen);
         return 1;
     }
     return 0;
@@ -72,92 +180,286 @@ int winput()
 
 int main(int argc, char *argv[]) 
 {
-    if (argc != 2) 
+    // positional = name and table, options may come anywhere
+    char *positional[2];
+    int count;
+    count = 0;
+
+    int a;
+    for (a = 1; a < argc; a = a + 1)
+    {
+        if (strcmp(argv[a], "--bot") == 0 || strcmp(argv[a], "-b") == 0)
+        {
+            bot_mode = 1;
+        }
+        else if (strcmp(argv[a], "--watch") == 0 || strcmp(argv[a], "-w") == 0)
+        {
+            watch_mode = 1;
+        }
+        else if (strcmp(argv[a], "--think") == 0 && a + 1 < argc)
+        {
+            a = a + 1;
+            think_ms = atoi(argv[a]);
+        }
+        else if (argv[a][0] != '-' && count < 2)
+        {
+            positional[count] = argv[a];
+            count = count + 1;
+        }
+        else
+        {
+            count = -1;
+            break;
+        }
+    }
+
+    // a spectator takes only the table, a player needs at least a name
+    int usage;
+    usage = count == -1 || think_ms < 0;
+    if (watch_mode == 1 && (count > 1 || bot_mode == 1))
+    {
+        usage = 1;
+    }
+    if (watch_mode == 0 && count == 0)
+    {
+        usage = 1;
+    }
+
+    if (usage == 1) 
     {
-        printf("Usage: %s <YourName>\n", argv[0]);
+        printf("Usage: %s [--bot [--think ms]] <YourName> [table]\n", argv[0]);
+        printf("       %s --watch [table]\n", argv[0]);
         printf("Example: %s Alice\n", argv[0]);
+        printf("Without a table number the server lobby seats you at the next table to start\n");
+        printf("--bot rolls on its own after think ms, draws nothing and prints its roll latencies at exit\n");
+        printf("--watch follows a table (default 0) without taking a seat, any number can watch at once\n");
         return 1;
     }
+
+    int picked; // picked = table given on the command line
+    picked = 0;
+    if (watch_mode == 1)
+    {
+        my_table = count == 1 ? atoi(positional[0]) : 0;
+    }
+    else
+    {
+        if (count == 2)
+        {
+            my_table = atoi(positional[1]);
+            picked = 1;
+        }
+
+        strncpy(my_name, positional[0], sizeof(my_name) - 1);
+        my_name[sizeof(my_name) - 1] = '\0';
+    }
     
-    strncpy(my_name, argv[1], sizeof(my_name) - 1);
-    my_name[sizeof(my_name) - 1] = '\0';
-    
-    printf("\n");
-    printf("===========================================\n");
-    printf("  DICE RACE GAME - PLAYER CLIENT\n");
-    printf("===========================================\n");
-    printf("  Player: %s\n", my_name);
-    printf("===========================================\n");
-    printf("\n");
-    printf("GAME RULES:\n");
-    printf("- Minimum %d players needed to start\n", 3);
-    printf("- Maximum %d players can join\n", MXP);
-    printf("- Race to Row %d to WIN!\n", WC);
-    printf("- Press ENTER to roll the dice\n");
-    printf("- Wait patiently for your turn\n");
-    printf("\n");
-    printf("Good luck, %s! May the dice be with you!\n", my_name);
-    printf("===========================================\n");
-    printf("\n");
-    
+    if (bot_mode == 1 || watch_mode == 1)
+    {
+        // no SA_RESTART, a bot asleep on a futex or in poll() has to notice the signal
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = bot_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+    }
+
     ssm();
+
+    // the rules are the server's, only known once we are attached
+    if (bot_mode == 0 && watch_mode == 0)
+    {
+        printf("\n");
+        printf("===========================================\n");
+        printf("  DICE RACE GAME - PLAYER CLIENT\n");
+        printf("===========================================\n");
+        printf("  Player: %s\n", my_name);
+        printf("===========================================\n");
+        printf("\n");
+        printf("GAME RULES:\n");
+        printf("- Minimum %d players needed to start\n", shm->min_players);
+        printf("- Maximum %d players can join\n", shm->slots);
+        printf("- Race to Row %d to WIN!\n", shm->goal);
+        printf("- Press ENTER to roll the dice\n");
+        printf("- Wait patiently for your turn\n");
+        printf("\n");
+        printf("Good luck, %s! May the dice be with you!\n", my_name);
+        printf("===========================================\n");
+        printf("\n");
+    }
+
+    if (my_table >= shm->tables)
+    {
+        fprintf(stderr, "ERROR: Server only hosts tables 0 to %d\n", shm->tables - 1);
+        cr();
+        return 1;
+    }
+
+    if (vn(&view, shm->slots) == -1)
+    {
+        fprintf(stderr, "ERROR: Out of memory for a %d seat table\n", shm->slots);
+        cr();
+        return 1;
+    }
+
+    int result;
+    if (watch_mode == 1)
+    {
+        result = wt();
+        cr();
+        return result;
+    }
+
+    result = og(picked);
+
+    while (result == 0 && ag(picked) == 1)
+    {
+        result = og(picked);
+    }
     
-    my_player_id = Fslot();
+    if (bot_mode == 1)
+    {
+        bs();
+    }
+    cr();
+    return result;
+}
+
+// take a seat, wait for the start, play and show the results, returns 1 if we never got to play
+int og(int picked)
+{
+    if (picked == 1)
+    {
+        my_player_id = Ftable();
+    }
+    else
+    {
+        my_player_id = lq();
+    }
     
     if (my_player_id == -1) 
     {
-        fprintf(stderr, "ERROR: Game is full (%d players maximum)\n", MXP);
-        cr();
+        if (bot_stop == 1)
+        {
+            return 1; // stopped while still queued in the lobby
+        }
+        if (picked == 1)
+        {
+            fprintf(stderr, "ERROR: Table %d is full (%d players maximum)\n", my_table, shm->slots);
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: The lobby is closed, the server is shutting down\n");
+        }
         return 1;
     }
     
-    printf("Assigned to slot: %d\n", my_player_id + 1);
-    
-    pthread_mutex_lock(&gptr->shm_lock);
-    strncpy(gptr->PN[my_player_id], my_name, 49);
-    gptr->PN[my_player_id][49] = '\0';
-    pthread_mutex_unlock(&gptr->shm_lock);
+    my_games = gptr->games;
+
+    // a new seat may be at another table, nothing copied from the old one is valid
+    view.gen = 1;
+    drawn_gen = 1;
+    scr_valid = 0;
+    ev_ok = 0;
+    printf("Assigned to table %d, slot: %d\n", my_table, my_player_id + 1);
     
-    Cfifo();
-    printf("Connected to server successfully!\n");
-    printf("Waiting for other players to join...\n");
-    printf("(Minimum %d players required)\n\n", gptr->mnpr);
+    if (shm->socket == 1)
+    {
+        // the server takes the connection itself as our join
+        if (sc() == -1)
+        {
+            fprintf(stderr, "ERROR: Cannot connect to the server socket %s\n", sock_path);
+            return 1;
+        }
+    }
+    else
+    {
+        if (shm->mailbox == 0)
+        {
+            Cfifo();
+        }
+
+        if (nj() == -1)
+        {
+            fprintf(stderr, "ERROR: Cannot reach the server join FIFO %s\n", join_fifo);
+            return 1;
+        }
+    }
+    if (bot_mode == 0)
+    {
+        printf("Connected to server successfully!\n");
+        printf("Waiting for other players to join...\n");
+        printf("(Minimum %d players required)\n\n", gptr->mnpr);
+    }
     
     char join_message[100];
     snprintf(join_message, sizeof(join_message), "%s joined the game", my_name);
     
-    int lastPC;// lastPC = last player count
-    lastPC = -1;
-    
-    while (gptr->game_active == 0) 
+    while (gptr->game_active == 0 && shm->stopping == 0 && bot_stop == 0) 
     {
-        int cc; // cc = current count
-        cc = gptr->CP;
-        
-        if (cc != lastPC) 
+        unsigned int state_seen; // sleep until the server reports a join or the game start
+        state_seen = __atomic_load_n(&gptr->state_ftx, __ATOMIC_ACQUIRE);
+
+        // state_ftx also moves for slot claims, only a new gen can change the count
+        if (bot_mode == 0 && gs(gptr, &view) == 1) 
+        {
+            ed(join_message, sizeof(join_message));
+
+            char waiting[100];
+            snprintf(waiting, sizeof(waiting), "Waiting for players... %d/%d connected (minimum)", 
+                     view.CP, gptr->mnpr);
+            sg(join_message, waiting);
+        }
+
+        if (gptr->game_active == 0 && shm->stopping == 0 && bot_stop == 0)
         {
-            lastPC = cc;
-            printf("Players connected: %d/%d (minimum)\n", 
-                   cc, gptr->mnpr);
-            sg(join_message, "Waiting for players...");
+            fw(&gptr->state_ftx, state_seen, NULL);
         }
-        sleep(1);
+    }
+
+    if (bot_stop == 1)
+    {
+        return 1;
+    }
+
+    if (gptr->game_active == 0)
+    {
+        fprintf(stderr, "ERROR: The server shut down before the game started\n");
+        return 1;
+    }
+
+    if (bot_mode == 1)
+    {
+        play();
+        gs(gptr, &view);
+        printf("[Bot %s] Table %d game over, winner %s, I reached R%d\n",
+               my_name, my_table, view.FW >= 0 ? view.PN[view.FW] : "nobody", view.PP[my_player_id]);
+        return 0;
     }
     
+    gs(gptr, &view);
     printf("\n===========================================\n");
     printf("  GAME STARTED!\n");
     printf("===========================================\n");
-    printf("  Race to position %d!\n", WC);
-    printf("  %d players are competing!\n", gptr->CP);
+    printf("  Race to position %d!\n", shm->goal);
+    printf("  %d players are competing!\n", view.CP);
     printf("\n");
     printf("  Ready... Set... ROLL!\n");
     printf("===========================================\n\n");
+    scr_valid = 0; // the banner scrolled the board, draw the next frame whole
     
     play();
     
     sleep(1);
     
     sg("GAME OVER!", "Final Results");
+
+    // sg() took the final snapshot, the results below all come from it
+    if (view.FW < 0)
+    {
+        printf("\nThe game was stopped before anyone won\n");
+        return 0;
+    }
     
     char result_filename[256];
     snprintf(result_filename, sizeof(result_filename), "result_%s.txt", my_name);
@@ -168,19 +470,19 @@ int main(int argc, char *argv[])
     if (result_file != NULL) 
     {
         fprintf(result_file, "Game Results for %s\n", my_name);
-        fprintf(result_file, "Winner: %s\n", gptr->PN[gptr->FW]);
-        fprintf(result_file, "My Total Wins: %d\n", gptr->TWN[my_player_id]);
-        fprintf(result_file, "Final Position: R%d\n", gptr->PP[my_player_id]);
+        fprintf(result_file, "Winner: %s\n", view.PN[view.FW]);
+        fprintf(result_file, "My Total Wins: %d\n", view.TWN[my_player_id]);
+        fprintf(result_file, "Final Position: R%d\n", view.PP[my_player_id]);
         fclose(result_file);
     }
 
     printf("\n##########################################\n");
-    if (gptr->FW == my_player_id) 
+    if (view.FW == my_player_id) 
     {
         printf("#                                        #\n");
         printf("#      CONGRATULATIONS! YOU WON!         #\n");
         printf("#                                        #\n");
-        printf("#   You reached Row %d first!            #\n", WC);
+        printf("#   You reached Row %d first!            #\n", shm->goal);
         printf("#         CHAMPION: %s!                  #\n", my_name);
         printf("#                                        #\n");
     } 
@@ -189,23 +491,65 @@ int main(int argc, char *argv[])
         printf("#                                        #\n");
         printf("#            GAME OVER!                  #\n");
         printf("#                                        #\n");
-        printf("#          Winner: %s                    #\n", gptr->PN[gptr->FW]);
+        printf("#          Winner: %s                    #\n", view.PN[view.FW]);
         printf("#   Better luck next time, %s!           #\n", my_name);
         printf("#                                        #\n");
     }
     printf("##########################################\n");
     
-    printf("\nTotal Wins for %s: %d\n", my_name, gptr->TWN[my_player_id]);
+    printf("\nTotal Wins for %s: %d\n", my_name, view.TWN[my_player_id]);
     printf("------------------------------------------\n");
     
-    cr();
     return 0;
 }
 
+// continuous mode only, stay connected and sit down again once the table is reset
+int ag(int picked)
+{
+    if (shm->continuous == 0 || shm->stopping == 1 || bot_stop == 1)
+    {
+        return 0;
+    }
+
+    // a bot keeps playing until the server shuts down
+    if (bot_mode == 0)
+    {
+        printf("\nPress ENTER to play another game, or q then ENTER to quit: ");
+        fflush(stdout);
+
+        char line[16];
+        if (fgets(line, sizeof(line), stdin) == NULL || line[0] == 'q')
+        {
+            return 0;
+        }
+    }
+
+    rs();
+
+    // the lobby only seats at tables that are ready, our own table has to be reset first
+    while (picked == 1 && gptr->games == my_games && shm->stopping == 0 && bot_stop == 0)
+    {
+        unsigned int state_seen;
+        state_seen = __atomic_load_n(&gptr->state_ftx, __ATOMIC_ACQUIRE);
+
+        if (gptr->games == my_games && shm->stopping == 0)
+        {
+            fw(&gptr->state_ftx, state_seen, NULL);
+        }
+    }
+
+    if (shm->stopping == 1 || bot_stop == 1)
+    {
+        return 0;
+    }
+    return 1;
+}
+
 void ssm() 
 {
+    // a spectator maps the segment read only, whatever it does it cannot disturb the players
     int shm_fd;
-    shm_fd = shm_open("/dice_game_shm", O_RDWR, 0666);
+    shm_fd = shm_open(shm_name, watch_mode == 1 ? O_RDONLY : O_RDWR, 0666);
     
     if (shm_fd == -1) 
     {
@@ -214,45 +558,199 @@ void ssm()
         fprintf(stderr, "Make sure server is running!\n");
         exit(1);
     }
+
+    // the segment size depends on how many tables and seats the server hosts, lv() checks it against the header
+    struct stat shm_stat;
+    if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < sizeof(struct ShmHeader))
+    {
+        fprintf(stderr, "ERROR: Server shared memory is not ready yet\n");
+        exit(1);
+    }
+    shm_len = shm_stat.st_size;
     
-    gptr = mmap(NULL, sizeof(struct GameInfo), 
-                    PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    shm = mmap(NULL, shm_len, 
+                    watch_mode == 1 ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
     
-    if (gptr == MAP_FAILED) 
+    if (shm == MAP_FAILED) 
     {
         perror("Memory mapping failed");
         exit(1);
     }
     
     close(shm_fd);
+
+    int layout;
+    layout = lv(shm, shm_len);
+    if (layout == -1)
+    {
+        fprintf(stderr, "ERROR: Server shared memory is not ready yet\n");
+        exit(1);
+    }
+    if (layout == -2)
+    {
+        fprintf(stderr, "ERROR: Server uses another shared memory layout (version %u, table info %u bytes, we expect version %d, %d bytes)\n",
+                shm->version, shm->info_size, SHM_VERSION, (int)sizeof(struct GameInfo));
+        fprintf(stderr, "Rebuild client and server from the same sources\n");
+        exit(1);
+    }
+}
+
+// sit at the table picked on the command line
+int Ftable()
+{
+    gptr = tp(shm, my_table);
+    return Fslot();
 }
 
 int Fslot() 
 {
-    pthread_mutex_lock(&gptr->shm_lock);
-    
-    int available_slot;
-    available_slot = -1;
-    
-    int i;
-    for (i = 0; i < MXP; i = i + 1) 
+    int slot;
+    slot = cl(gptr, getpid(), my_name);
+    if (slot == -1)
+    {
+        __atomic_add_fetch(&gptr->counters.slot_full, 1, __ATOMIC_RELAXED);
+    }
+    return slot;
+}
+
+// no table picked, queue in the server lobby and wait until it seats us
+int lq()
+{
+    char reply_path[64];
+    lpath(reply_path, sizeof(reply_path), getpid());
+
+    unlink(reply_path);
+    if (mkfifo(reply_path, 0666) == -1)
+    {
+        perror("Lobby FIFO creation failed");
+        return -1;
+    }
+
+    // open our end first so the server's non-blocking open for writing succeeds
+    int reply_fd;
+    reply_fd = open(reply_path, O_RDONLY | O_NONBLOCK);
+
+    struct JoinMsg msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = JM_LOBBY;
+    msg.table = -1;
+    msg.slot = -1;
+    msg.pid = getpid();
+    strncpy(msg.name, my_name, sizeof(msg.name) - 1);
+
+    if (reply_fd == -1 || jw(&msg) == -1)
     {
-        if (gptr->player_active[i] == 0) 
+        fprintf(stderr, "ERROR: Cannot reach the server join FIFO %s\n", join_fifo);
+        if (reply_fd != -1)
         {
-            available_slot = i;
-            break;
+            close(reply_fd);
         }
+        unlink(reply_path);
+        return -1;
     }
-    
-    pthread_mutex_unlock(&gptr->shm_lock);
-    return available_slot;
+
+    printf("Waiting in the lobby for a table...\n");
+
+    struct pollfd pfd;
+    pfd.fd = reply_fd;
+    pfd.events = POLLIN;
+
+    while (poll(&pfd, 1, -1) == -1 && errno == EINTR && bot_stop == 0)
+    {
+    }
+    if (read(reply_fd, &msg, sizeof(msg)) != sizeof(msg))
+    {
+        msg.table = -1;
+    }
+
+    close(reply_fd);
+    unlink(reply_path);
+
+    if (msg.table < 0 || msg.table >= shm->tables)
+    {
+        return -1;
+    }
+
+    my_table = msg.table;
+    gptr = tp(shm, my_table);
+    return msg.slot;
+}
+
+// jw = join write, one record on the server join FIFO
+int jw(struct JoinMsg *msg)
+{
+    int join_fd;
+    join_fd = open(join_fifo, O_WRONLY | O_NONBLOCK);
+
+    if (join_fd == -1)
+    {
+        return -1;
+    }
+
+    ssize_t written;
+    written = write(join_fd, msg, sizeof(*msg));
+    close(join_fd);
+
+    if (written != sizeof(*msg))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int sc()
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+
+    sock_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (sock_fd == -1)
+    {
+        return -1;
+    }
+
+    if (connect(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        close(sock_fd);
+        sock_fd = -1;
+        return -1;
+    }
+
+    // the first packet names the slot we claimed, the server checks it against our pid from the kernel
+    struct JoinMsg msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = JM_JOIN;
+    msg.table = my_table;
+    msg.slot = my_player_id;
+    msg.pid = getpid();
+    if (send(sock_fd, &msg, sizeof(msg), 0) != sizeof(msg))
+    {
+        close(sock_fd);
+        sock_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// tell the server about our claimed slot, it starts serving us as soon as it reads this
+int nj()
+{
+    struct JoinMsg msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = JM_JOIN;
+    msg.table = my_table;
+    msg.slot = my_player_id;
+    msg.pid = getpid();
+    return jw(&msg);
 }
 
 void Cfifo() 
 {
     char fifo_path[256];
     
-    snprintf(fifo_path, sizeof(fifo_path), "%s%d_to_server", fifo_p, my_player_id);
+    fpath(fifo_path, sizeof(fifo_path), my_table, my_player_id, "to_server");
     int result;
     result = mkfifo(fifo_path, 0666);
     if (result == -1 && errno != EEXIST) 
@@ -260,7 +758,7 @@ void Cfifo()
         perror("FIFO creation failed");
     }
     
-    snprintf(fifo_path, sizeof(fifo_path), "%s%d_from_server", fifo_p, my_player_id);
+    fpath(fifo_path, sizeof(fifo_path), my_table, my_player_id, "from_server");
     result = mkfifo(fifo_path, 0666);
     if (result == -1 && errno != EEXIST) 
     {
@@ -268,77 +766,409 @@ void Cfifo()
     }
 }
 
-void sg(const char *last_action, const char *current_status) 
+// six characters per column plus room for the row label, 54 for the classic five seats
+void hl(int cols)
 {
-    printf("\033[H\033[J");
-    
-    printf("==========================================\n");
-    printf("    DICE RACE - ROUND %d\n", gptr->round);
-    printf("==========================================\n");
-    
-    int row;
-    for (row = WC; row >= 1; row = row - 1) 
+    int i;
+    for (i = 0; i < cols; i = i + 1)
     {
-        printf("|");
-        
-        int p;
-        for (p = 0; p < MXP; p = p + 1) 
+        sn(&scr_now, "------", 6);
+    }
+    sn(&scr_now, "------------------------\n", 25);
+}
+
+void sn(struct Screen *s, const char *bytes, size_t n)
+{
+    if (s->len + n > s->cap)
+    {
+        size_t cap;
+        cap = s->cap * 2 + n + 256;
+
+        char *grown;
+        grown = realloc(s->text, cap);
+        if (grown == NULL)
         {
-            char display_char;
+            return; // out of memory, this frame is cut short and the next one redraws it
+        }
+        s->text = grown;
+        s->cap = cap;
+    }
+    memcpy(s->text + s->len, bytes, n);
+    s->len = s->len + n;
+}
+
+void sw(struct Screen *s, const char *format, ...)
+{
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int n;
+    n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (n > 0)
+    {
+        sn(s, line, n < (int)sizeof(line) ? (size_t)n : sizeof(line) - 1);
+    }
+}
+
+// split text into lines, at[] gets one entry per line plus the end of the text
+void si(struct Screen *s)
+{
+    s->lines = 0;
+    s->width = 0;
+
+    size_t start;
+    start = 0;
+
+    size_t i;
+    for (i = 0; i <= s->len; i = i + 1)
+    {
+        if (i < s->len && s->text[i] != '\n')
+        {
+            continue;
+        }
+        if (i == s->len && i == start)
+        {
+            break; // text ended in a newline
+        }
+
+        if (s->lines + 2 > s->line_cap)
+        {
+            int cap;
+            cap = s->line_cap * 2 + 64;
+
+            size_t *grown;
+            grown = realloc(s->at, cap * sizeof(size_t));
+            if (grown == NULL)
+            {
+                break;
+            }
+            s->at = grown;
+            s->line_cap = cap;
+        }
+
+        s->at[s->lines] = start;
+        s->lines = s->lines + 1;
+        if ((int)(i - start) > s->width)
+        {
+            s->width = i - start;
+        }
+        start = i + 1;
+    }
+
+    if (s->at != NULL)
+    {
+        s->at[s->lines] = start;
+    }
+}
+
+// the frame in scr_now goes out as one write(), only the cells that differ from scr_was unless a full redraw is needed
+void sd()
+{
+    si(&scr_now);
+
+    // printf() output still buffered has to reach the terminal before our escape codes
+    fflush(stdout);
+
+    // keys typed while waiting were echoed and may have scrolled the screen under us
+    int typed;
+    typed = 0;
+    if (ioctl(STDIN_FILENO, FIONREAD, &typed) == 0 && typed > typed_seen)
+    {
+        scr_valid = 0;
+    }
+    typed_seen = typed;
+
+    int rows;
+    int cols;
+    rows = 0;
+    cols = 0;
+
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0)
+    {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    }
+
+    scr_out.len = 0;
+
+    // diffs address rows by number, a frame the terminal has to scroll or wrap is sent whole
+    if (scr_valid == 0 || scr_now.lines >= rows || scr_now.width >= cols)
+    {
+        sw(&scr_out, "\033[H\033[J");
+        sn(&scr_out, scr_now.text, scr_now.len);
+    }
+    else
+    {
+        int i;
+        for (i = 0; i < scr_now.lines; i = i + 1)
+        {
+            const char *now;
+            int now_len;
+            now = scr_now.text + scr_now.at[i];
+            now_len = scr_now.at[i + 1] - scr_now.at[i] - 1;
+
+            const char *was;
+            int was_len;
+            was = "";
+            was_len = 0;
+            if (i < scr_was.lines)
+            {
+                was = scr_was.text + scr_was.at[i];
+                was_len = scr_was.at[i + 1] - scr_was.at[i] - 1;
+            }
+
+            if (i < scr_was.lines && now_len == was_len && memcmp(now, was, now_len) == 0)
+            {
+                continue;
+            }
+
+            // skip what both lines share at the start, and at the end when they are the same length
+            int first;
+            first = 0;
+            while (first < now_len && first < was_len && now[first] == was[first])
+            {
+                first = first + 1;
+            }
+
+            int end;
+            end = now_len;
+            if (now_len == was_len)
+            {
+                while (end > first && now[end - 1] == was[end - 1])
+                {
+                    end = end - 1;
+                }
+            }
+
+            sw(&scr_out, "\033[%d;%dH", i + 1, first + 1);
+            sn(&scr_out, now + first, end - first);
+            if (now_len < was_len)
+            {
+                sw(&scr_out, "\033[K");
+            }
+        }
+
+        if (scr_was.lines > scr_now.lines)
+        {
+            sw(&scr_out, "\033[%d;1H\033[J", scr_now.lines + 1);
+        }
+        if (scr_out.len > 0)
+        {
+            sw(&scr_out, "\033[%d;1H", scr_now.lines + 1);
+        }
+    }
+
+    size_t sent;
+    sent = 0;
+    while (sent < scr_out.len)
+    {
+        ssize_t written;
+        written = write(STDOUT_FILENO, scr_out.text + sent, scr_out.len - sent);
+        if (written <= 0)
+        {
+            if (written == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        sent = sent + written;
+    }
+
+    struct Screen kept;
+    kept = scr_was;
+    scr_was = scr_now;
+    scr_now = kept;
+    scr_now.len = 0;
+    scr_valid = 1;
+}
+
+// only events before view.ev, so every name we print comes from the same snapshot as the board
+// returns 1 when text was rewritten
+int ed(char *text, size_t n)
+{
+    if (ev_ok == 0)
+    {
+        ev_at = view.ev;
+        ev_ok = 1;
+        return 0;
+    }
+
+    int changed;
+    changed = 0;
+
+    int rolled; // rolled = dice of the last ROLL, its MOVE follows it
+    rolled = 0;
+
+    struct Event e;
+    while (ev_at != view.ev)
+    {
+        int got;
+        got = et(gptr, &ev_at, &e);
+        if (got == -1)
+        {
+            // the ring lapped us, a fresh snapshot already holds everything we skipped
+            view.gen = 1;
+            gs(gptr, &view);
+            ev_at = view.ev;
+            break;
+        }
+        if (got == 0)
+        {
+            break;
+        }
+
+        if (e.player == my_player_id)
+        {
+            continue;
+        }
+
+        if (e.type == ET_ROLL)
+        {
+            rolled = e.arg;
+        }
+        else if (e.type == ET_MOVE)
+        {
+            snprintf(text, n, "%s rolled a %d! Moved to R%d", view.PN[e.player], rolled, e.arg);
+            changed = 1;
+        }
+        else if (e.type == ET_WIN)
+        {
+            snprintf(text, n, "%s reached R%d and wins!", view.PN[e.player], e.arg);
+            changed = 1;
+        }
+        else if (e.type == ET_JOIN)
+        {
+            snprintf(text, n, "%s joined the game", view.PN[e.player]);
+            changed = 1;
+        }
+        else if (e.type == ET_LEAVE)
+        {
+            snprintf(text, n, "%s left the game", view.PN[e.player]);
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+void sg(const char *last_action, const char *current_status) 
+{
+    if (bot_mode == 1)
+    {
+        return;
+    }
+
+    if (last_action == NULL)
+    {
+        last_action = "";
+    }
+    if (current_status == NULL)
+    {
+        current_status = "";
+    }
+
+    // same board and same texts, the screen already shows exactly this
+    gs(gptr, &view);
+    if (scr_valid == 1 && view.gen == drawn_gen && strcmp(last_action, drawn_action) == 0 && strcmp(current_status, drawn_status) == 0)
+    {
+        return;
+    }
+    drawn_gen = view.gen;
+    snprintf(drawn_action, sizeof(drawn_action), "%s", last_action);
+    snprintf(drawn_status, sizeof(drawn_status), "%s", current_status);
+
+    sw(&scr_now, "==========================================\n");
+    sw(&scr_now, "    DICE RACE - TABLE %d - ROUND %d\n", my_table, view.round);
+    sw(&scr_now, "==========================================\n");
+    
+    // small tables keep a column per seat, big ones only show the seats in play
+    int cols;
+    cols = 0;
+    int p;
+    for (p = 0; p < view.slots; p = p + 1)
+    {
+        if (view.slots <= MXP || view.player_active[p] == 1)
+        {
+            cols = cols + 1;
+        }
+    }
+
+    int row;
+    for (row = shm->goal; row >= 1; row = row - 1) 
+    {
+        sw(&scr_now, "|");
+        
+        for (p = 0; p < view.slots; p = p + 1) 
+        {
+            if (view.slots > MXP && view.player_active[p] == 0)
+            {
+                continue;
+            }
+
+            char display_char;
             display_char = ' ';
             
-            if (gptr->player_active[p] == 1 && gptr->PP[p] == row) 
+            if (view.player_active[p] == 1 && view.PP[p] == row) 
             {
-                display_char = gptr->PN[p][0];
+                display_char = view.PN[p][0];
             }
             
-            printf("  %c  |", display_char);
+            sw(&scr_now, "  %c  |", display_char);
         }
         
-        printf(" R%-2d\n", row);
-        printf("------------------------------------------------------\n");
+        sw(&scr_now, " R%-2d\n", row);
+        hl(cols);
     }
     
-    printf("|");
-    int p;
-    for (p = 0; p < MXP; p = p + 1) 
+    sw(&scr_now, "|");
+    for (p = 0; p < view.slots; p = p + 1) 
     {
+        if (view.slots > MXP && view.player_active[p] == 0)
+        {
+            continue;
+        }
+
         char display_char;
         display_char = ' ';
         
-        if (gptr->player_active[p] == 1 && gptr->PP[p] == 0) 
+        if (view.player_active[p] == 1 && view.PP[p] == 0) 
         {
-            display_char = gptr->PN[p][0];
+            display_char = view.PN[p][0];
         }
         
-        printf("  %c  |", display_char);
+        sw(&scr_now, "  %c  |", display_char);
     }
-    printf(" Start (R0)\n");
-    printf("------------------------------------------------------\n");
+    sw(&scr_now, " Start (R0)\n");
+    hl(cols);
     
-    printf("\nCurrent Standings:\n");
+    sw(&scr_now, "\nCurrent Standings:\n");
     int i;
-    for (i = 0; i < MXP; i = i + 1) 
+    for (i = 0; i < view.slots; i = i + 1) 
     {
-        if (gptr->player_active[i] == 1) 
+        if (view.player_active[i] == 1) 
         {
-            printf("  %-10s | Position: R%-2d\n", 
-                   gptr->PN[i], 
-                   gptr->PP[i]);
+            sw(&scr_now, "  %-10s | Position: R%-2d\n", 
+                   view.PN[i], 
+                   view.PP[i]);
         }
     }
     
-    printf("\n------------------------------------------\n");
+    sw(&scr_now, "\n------------------------------------------\n");
     
-    if (last_action != NULL && strlen(last_action) > 0) 
+    if (strlen(last_action) > 0) 
     {
-        printf(">> %s\n", last_action);
+        sw(&scr_now, ">> %s\n", last_action);
     }
     
-    if (current_status != NULL) 
+    if (strlen(current_status) > 0) 
     {
-        printf(">> %s\n", current_status);
+        sw(&scr_now, ">> %s\n", current_status);
     }
+
+    sd();
 }
 
 void play() 
@@ -346,59 +1176,90 @@ void play()
     char fifo_write_path[256];
     char fifo_read_path[256];
     
-    snprintf(fifo_write_path, sizeof(fifo_write_path), 
-             "%s%d_to_server", fifo_p, my_player_id);
-    snprintf(fifo_read_path, sizeof(fifo_read_path), 
-             "%s%d_from_server", fifo_p, my_player_id);
+    fpath(fifo_write_path, sizeof(fifo_write_path), my_table, my_player_id, "to_server");
+    fpath(fifo_read_path, sizeof(fifo_read_path), my_table, my_player_id, "from_server");
     
     int fd_write;
     int fd_read;
+    fd_write = -1;
+    fd_read = -1;
     
-    fd_write = open(fifo_write_path, O_WRONLY);
-    fd_read = open(fifo_read_path, O_RDONLY | O_NONBLOCK);
-    
-    if (fd_write == -1 || fd_read == -1) 
+    // --mailbox servers take the frames straight from shared memory, --socket ones use our connection
+    if (shm->socket == 1)
     {
-        return;
+        fd_write = sock_fd;
+        fd_read = sock_fd;
+    }
+    else if (shm->mailbox == 0)
+    {
+        fd_write = open(fifo_write_path, O_WRONLY);
+        fd_read = open(fifo_read_path, O_RDONLY | O_NONBLOCK);
+        
+        if (fd_write == -1 || fd_read == -1) 
+        {
+            return;
+        }
     }
     
     srand(time(NULL) ^ getpid());
+
+    struct FrameIn in; // in = reply frames read but not handled yet
+    in.len = 0;
     
     char my_last_action[256];
     strcpy(my_last_action, "");
     
     char current_status[256];
 
-    while (1) 
+    int waited; // waited = we saw someone else's turn, the next turn of ours was handed to us by the server
+    waited = 0;
+
+    while (bot_stop == 0) 
     {
-        if (gptr->game_active == 0) 
+        unsigned int state_seen; // redraw only when the server bumps the state word
+        state_seen = __atomic_load_n(&gptr->state_ftx, __ATOMIC_ACQUIRE);
+
+        // CT and the name it points at come from the same snapshot, never from two different turns
+        gs(gptr, &view);
+        if (view.game_active == 0) 
         {
             break;
         }
-        
-        if (gptr->CT != my_player_id) 
+
+        if (bot_mode == 0)
         {
-            if (gptr->game_active == 0) 
-            {
-                break;
-            }
-            
+            ed(my_last_action, sizeof(my_last_action));
+        }
+
+        if (view.CT != my_player_id) 
+        {
+            waited = 1;
             snprintf(current_status, sizeof(current_status), 
                      "Waiting for %s's turn...", 
-                     gptr->PN[gptr->CT]);
+                     view.PN[view.CT]);
             
             sg(my_last_action, current_status);
-            usleep(500000);
+            fw(&gptr->state_ftx, state_seen, NULL);
             continue;
         }
 
-        if (gptr->game_active == 0) 
+        if (waited == 1)
         {
-            break;
+            hr(&shm->lat[PH_WAKE], mn() - __atomic_load_n(&gptr->turn_ts, __ATOMIC_RELAXED));
+            waited = 0;
         }
 
         int key_pressed;
         key_pressed = 0;
+
+        if (bot_mode == 1)
+        {
+            if (think_ms > 0)
+            {
+                usleep(think_ms * 1000);
+            }
+            key_pressed = 1;
+        }
         
         while (gptr->game_active == 1 && key_pressed == 0)
         {
@@ -416,34 +1277,22 @@ void play()
             break;
         }
 
-        char buffer[256];
-        strcpy(buffer, "ROLL");
-        write(fd_write, buffer, strlen(buffer) + 1);
+        long long asked; // asked = when the ROLL went out
+        asked = mn();
 
-        memset(buffer, 0, sizeof(buffer));
-        ssize_t bytes_read;
-        int read_attempts;
-        read_attempts = 0;
-        
-        while (read_attempts < 100 && gptr->game_active == 1)
+        int dice_value;
+        dice_value = rq(fd_write, fd_read, &in);
+
+        if (bot_mode == 1)
         {
-            bytes_read = read(fd_read, buffer, sizeof(buffer));
-            
-            if (bytes_read > 0)
-            {
-                break;
-            }
-            
-            usleep(50000);
-            read_attempts = read_attempts + 1;
+            bt(mn() - asked, dice_value);
+            continue;
         }
         
-        if (bytes_read > 0) 
+        if (dice_value > 0) 
         {
-            int dice_value;
-            sscanf(buffer, "ROLLED %d", &dice_value);
-
-            snprintf(my_last_action, sizeof(my_last_action), "You rolled a %d! Moved to R%d", dice_value, gptr->PP[my_player_id]);
+            gs(gptr, &view);
+            snprintf(my_last_action, sizeof(my_last_action), "You rolled a %d! Moved to R%d", dice_value, view.PP[my_player_id]);
             
             sg(my_last_action, "Turn completed");
             
@@ -461,23 +1310,211 @@ void play()
         }
     }
     
-    close(fd_write);
-    close(fd_read);
+    // the socket stays open until rs(), closing it is how the server learns we left
+    if (fd_write != -1 && fd_write != sock_fd)
+    {
+        close(fd_write);
+    }
+    if (fd_read != -1 && fd_read != sock_fd)
+    {
+        close(fd_read);
+    }
+}
+
+// send one ROLL and wait for the ROLLED with the same seq, returns the dice value or 0 after 5 seconds
+int rq(int fd_write, int fd_read, struct FrameIn *in)
+{
+    struct Frame request;
+    request.type = MT_ROLL;
+    request.player = my_player_id;
+    request.seq = my_seq + 1;
+    request.payload = 0;
+    request.ts = mn();
+    my_seq = request.seq;
+
+    long long deadline;
+    deadline = request.ts + 5000000000LL;
+
+    int dice_value;
+    dice_value = 0;
+
+    struct Frame reply;
+
+    if (shm->mailbox == 1)
+    {
+        if (ms(&mt(gptr)[my_player_id], &request) == -1)
+        {
+            return 0;
+        }
+
+        while (dice_value == 0 && mn() < deadline && bot_stop == 0)
+        {
+            struct timespec left;
+            left.tv_sec = (deadline - mn()) / 1000000000LL;
+            left.tv_nsec = (deadline - mn()) % 1000000000LL;
+            if (left.tv_nsec < 0)
+            {
+                break;
+            }
+
+            if (mr(&mf(gptr)[my_player_id], &reply, &left) == 1
+                && reply.type == MT_ROLLED && reply.seq == request.seq)
+            {
+                dice_value = reply.payload;
+                rl(&request, &reply);
+            }
+        }
+        return dice_value;
+    }
+
+    fo(fd_write, &request, 1);
+
+    // block until the handler answers our seq, giving up after 5 seconds like before
+    struct pollfd pfd;
+    pfd.fd = fd_read;
+    pfd.events = POLLIN;
+
+    while (dice_value == 0 && mn() < deadline && bot_stop == 0)
+    {
+        if (poll(&pfd, 1, (int)((deadline - mn()) / 1000000) + 1) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t bytes_read;
+        bytes_read = fi(fd_read, in);
+        if (bytes_read == 0)
+        {
+            break; // the server closed its end
+        }
+
+        // a late answer to an earlier roll may still be queued ahead of ours
+        while (fx(in, &reply) == 1)
+        {
+            if (reply.type == MT_ROLLED && reply.seq == request.seq)
+            {
+                dice_value = reply.payload;
+                rl(&request, &reply);
+            }
+        }
+    }
+    return dice_value;
+}
+
+// the ROLLED carries the handler's send time, our ROLL our own
+void rl(const struct Frame *request, const struct Frame *reply)
+{
+    long long now;
+    now = mn();
+    hr(&shm->lat[PH_REPLY], now - reply->ts);
+    hr(&shm->lat[PH_TOTAL], now - request->ts);
 }
 
 // clean resources 
 void cr()
 {
-    if (gptr != NULL) 
+    rs();
+
+    if (shm != NULL)
     {
-        munmap(gptr, sizeof(struct GameInfo));
+        munmap(shm, shm_len);
     }
-    
-    char fifo_path[256];
-    
-    snprintf(fifo_path, sizeof(fifo_path), "%s%d_to_server", fifo_p, my_player_id);
-    unlink(fifo_path);
-    
-    snprintf(fifo_path, sizeof(fifo_path), "%s%d_from_server", fifo_p, my_player_id);
-    unlink(fifo_path);
+}
+
+void rs()
+{
+    if (sock_fd != -1)
+    {
+        close(sock_fd);
+        sock_fd = -1;
+    }
+
+    if (my_player_id == -1)
+    {
+        return;
+    }
+
+    // FIFO names are per slot, once a continuous server reset the table the next player may already use them
+    // cl() claims without shm_lock, so the slot is only ours to give back if the CAS from our pid succeeds;
+    // the lock still keeps aj() from marking it active in between
+    pthread_mutex_lock(&gptr->shm_lock);
+    int unjoined; // unjoined = we only ever claimed the slot, dp() or rg() free a played seat
+    unjoined = pa(gptr)[my_player_id] == 0;
+
+    pid_t mine;
+    mine = getpid();
+    if (__atomic_compare_exchange_n(&sp(gptr)[my_player_id], &mine, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        char fifo_path[256];
+        
+        fpath(fifo_path, sizeof(fifo_path), my_table, my_player_id, "to_server");
+        unlink(fifo_path);
+        
+        fpath(fifo_path, sizeof(fifo_path), my_table, my_player_id, "from_server");
+        unlink(fifo_path);
+
+        if (unjoined == 1)
+        {
+            fr(gptr, my_player_id);
+        }
+    }
+    pthread_mutex_unlock(&gptr->shm_lock);
+
+    my_player_id = -1;
+}
+
+void bt(long long latency, int dice_value)
+{
+    if (dice_value == 0)
+    {
+        bot_missed = bot_missed + 1;
+        return;
+    }
+
+    if (bot_turns < BS)
+    {
+        bot_lat[bot_turns] = latency;
+    }
+    bot_turns = bot_turns + 1;
+    bot_sum = bot_sum + latency;
+    if (latency > bot_max)
+    {
+        bot_max = latency;
+    }
+}
+
+int lc(const void *a, const void *b)
+{
+    long long x;
+    long long y;
+    x = *(const long long *)a;
+    y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// percentiles come from the first BS turns, count, mean and max from all of them
+void bs()
+{
+    printf("[Bot %s] %d turns, %d unanswered rolls, %u board changes skipped\n", my_name, bot_turns, bot_missed, view.missed);
+    if (bot_turns == 0)
+    {
+        return;
+    }
+
+    int kept;
+    kept = bot_turns < BS ? bot_turns : BS;
+    qsort(bot_lat, kept, sizeof(long long), lc);
+
+    printf("[Bot %s] roll latency us: mean %lld p50 %lld p99 %lld max %lld\n",
+           my_name,
+           bot_sum / bot_turns / 1000,
+           bot_lat[kept * 50 / 100] / 1000,
+           bot_lat[kept * 99 / 100] / 1000,
+           bot_max / 1000);
+}
+
+void bot_signal(int sig)
+{
+    (void)sig;
+    bot_stop = 1;
 }
\ No newline at end of file
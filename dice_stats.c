@@ -0,0 +1,242 @@
+// OS Assignment - dice game - dice_stats.c (prints the server metrics straight from shared memory)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "game.h"
+
+struct ShmHeader *shm = NULL; // shm = whole mapped segment, read only
+size_t shm_len = 0;
+int json_mode = 0; // --json: one JSON object per sample instead of text
+
+// One reading of everything we print, taken in one go
+struct Sample
+{
+    long long at; // at = mn() when the sample was taken
+    struct Metrics m;
+    struct TableCounters c; // c = every table's counters added up
+    int playing; // tables with a game running
+    int players; // players seated at a table that is gathering or playing a game
+    unsigned long long changes; // changes = board changes over all tables, each gen step of 2 is one
+    unsigned int ring_depth; // records in the log ring not drained yet
+    unsigned int ring_dropped;
+};
+
+// Function declarations
+int om(); // om = open metrics, map the server segment read only
+void sm(struct Sample *s); // sm = sample metrics
+void pt(const struct Sample *s, double turn_rate); // pt = print text
+void pj(const struct Sample *s, double turn_rate); // pj = print JSON
+
+int main(int argc, char *argv[])
+{
+    int interval; // interval = seconds between samples, 0 = print once
+    interval = 0;
+
+    int a;
+    for (a = 1; a < argc; a = a + 1)
+    {
+        if (strcmp(argv[a], "--json") == 0 || strcmp(argv[a], "-j") == 0)
+        {
+            json_mode = 1;
+        }
+        else if ((strcmp(argv[a], "--interval") == 0 || strcmp(argv[a], "-i") == 0) && a + 1 < argc)
+        {
+            a = a + 1;
+            interval = atoi(argv[a]);
+        }
+        else
+        {
+            printf("Usage: %s [--json] [--interval seconds]\n", argv[0]);
+            printf("  --json      one JSON object per sample, for scrapers\n");
+            printf("  --interval  keep sampling, turns/sec is then measured over each interval\n");
+            return 1;
+        }
+    }
+
+    if (om() == -1)
+    {
+        return 1;
+    }
+
+    struct Sample last;
+    sm(&last);
+
+    // the first rate covers the whole server lifetime
+    double turn_rate;
+    turn_rate = 0.0;
+    if (last.at > last.m.started)
+    {
+        turn_rate = (double)last.c.turns * 1000000000.0 / (double)(last.at - last.m.started);
+    }
+
+    while (1)
+    {
+        if (json_mode == 1)
+        {
+            pj(&last, turn_rate);
+        }
+        else
+        {
+            pt(&last, turn_rate);
+        }
+        fflush(stdout);
+
+        if (interval <= 0 || shm->stopping == 1)
+        {
+            break;
+        }
+
+        sleep(interval);
+
+        struct Sample now;
+        sm(&now);
+        turn_rate = (double)(now.c.turns - last.c.turns) * 1000000000.0 / (double)(now.at - last.at);
+        last = now;
+    }
+
+    munmap(shm, shm_len);
+    return 0;
+}
+
+int om()
+{
+    int shm_fd;
+    shm_fd = shm_open(shm_name, O_RDONLY, 0);
+
+    if (shm_fd == -1)
+    {
+        fprintf(stderr, "ERROR: Cannot open %s: %s\n", shm_name, strerror(errno));
+        fprintf(stderr, "Make sure server is running!\n");
+        return -1;
+    }
+
+    struct stat shm_stat;
+    if (fstat(shm_fd, &shm_stat) == -1 || (size_t)shm_stat.st_size < sizeof(struct ShmHeader))
+    {
+        fprintf(stderr, "ERROR: Server shared memory is not ready yet\n");
+        close(shm_fd);
+        return -1;
+    }
+    shm_len = shm_stat.st_size;
+
+    // PROT_READ only, looking can never disturb a game
+    shm = mmap(NULL, shm_len, PROT_READ, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+
+    if (shm == MAP_FAILED)
+    {
+        perror("Memory mapping failed");
+        return -1;
+    }
+
+    if (lv(shm, shm_len) != 0)
+    {
+        fprintf(stderr, "ERROR: Server shared memory is not ready or was built from another game.h\n");
+        munmap(shm, shm_len);
+        return -1;
+    }
+    return 0;
+}
+
+// plain loads, every counter is only ever added to so a slightly torn sample is still sensible
+void sm(struct Sample *s)
+{
+    s->at = mn();
+    memcpy(&s->m, &shm->metrics, sizeof(struct Metrics));
+
+    memset(&s->c, 0, sizeof(struct TableCounters));
+    s->playing = 0;
+    s->players = 0;
+    s->changes = 0;
+
+    int t;
+    for (t = 0; t < shm->tables; t = t + 1)
+    {
+        struct GameInfo *g;
+        g = tp(shm, t);
+        if (g->game_active == 1)
+        {
+            s->playing = s->playing + 1;
+        }
+
+        // CP keeps counting the last game's players until rg() clears the table, a finished game
+        // (FW set) has nobody seated any more and only slots still marked active count
+        if (__atomic_load_n(&g->FW, __ATOMIC_ACQUIRE) == -1)
+        {
+            int i;
+            for (i = 0; i < g->slots; i = i + 1)
+            {
+                if (__atomic_load_n(&pa(g)[i], __ATOMIC_RELAXED) == 1)
+                {
+                    s->players = s->players + 1;
+                }
+            }
+        }
+        s->changes = s->changes + __atomic_load_n(&g->gen, __ATOMIC_RELAXED) / 2;
+
+        struct TableCounters c;
+        memcpy(&c, &g->counters, sizeof(c));
+        s->c.games_started = s->c.games_started + c.games_started;
+        s->c.games_finished = s->c.games_finished + c.games_finished;
+        s->c.turns = s->c.turns + c.turns;
+        s->c.joins = s->c.joins + c.joins;
+        s->c.slot_full = s->c.slot_full + c.slot_full;
+        s->c.lock_taken = s->c.lock_taken + c.lock_taken;
+        s->c.lock_waits = s->c.lock_waits + c.lock_waits;
+        s->c.lock_wait_ns = s->c.lock_wait_ns + c.lock_wait_ns;
+    }
+
+    s->ring_depth = __atomic_load_n(&shm->log_ring.head, __ATOMIC_RELAXED) - __atomic_load_n(&shm->log_ring.tail, __ATOMIC_RELAXED);
+    s->ring_dropped = __atomic_load_n(&shm->log_ring.dropped, __ATOMIC_RELAXED);
+}
+
+void pt(const struct Sample *s, double turn_rate)
+{
+    double wait_avg;
+    wait_avg = 0.0;
+    if (s->c.lock_waits > 0)
+    {
+        wait_avg = (double)s->c.lock_wait_ns / s->c.lock_waits / 1000.0;
+    }
+
+    printf("===========================================\n");
+    printf("  DICE RACE SERVER - uptime %llds\n", (s->at - s->m.started) / 1000000000LL);
+    printf("===========================================\n");
+    printf("  Tables playing        : %d of %d\n", s->playing, shm->tables);
+    printf("  Players seated        : %d\n", s->players);
+    printf("  Seats per table       : %u (game starts at %d, race to R%d)\n", shm->slots, shm->min_players, shm->goal);
+    printf("  Games started         : %llu\n", s->c.games_started);
+    printf("  Games finished        : %llu\n", s->c.games_finished);
+    printf("  Turns                 : %llu (%.1f/sec)\n", s->c.turns, turn_rate);
+    printf("  Board changes         : %llu\n", s->changes);
+    printf("  Joins                 : %llu\n", s->c.joins);
+    printf("  Joins refused         : %llu\n", s->m.join_refused);
+    printf("  Tables full (Fslot)   : %llu\n", s->c.slot_full);
+    printf("  Log queue depth       : %llu\n", s->m.log_depth);
+    printf("  Log ring depth        : %u (%u dropped)\n", s->ring_depth, s->ring_dropped);
+    printf("  shm_lock taken        : %llu\n", s->c.lock_taken);
+    printf("  shm_lock waits        : %llu (%.1f us total, %.1f us avg)\n",
+           s->c.lock_waits, s->c.lock_wait_ns / 1000.0, wait_avg);
+}
+
+void pj(const struct Sample *s, double turn_rate)
+{
+    printf("{\"uptime_s\":%lld,\"tables\":%d,\"tables_playing\":%d,\"players\":%d,"
+           "\"slots\":%u,\"min_players\":%d,\"goal\":%d,"
+           "\"games_started\":%llu,\"games_finished\":%llu,\"turns\":%llu,\"turns_per_sec\":%.1f,\"changes\":%llu,"
+           "\"joins\":%llu,\"join_refused\":%llu,\"slot_full\":%llu,"
+           "\"log_queue_depth\":%llu,\"log_ring_depth\":%u,\"log_dropped\":%u,"
+           "\"lock_taken\":%llu,\"lock_waits\":%llu,\"lock_wait_ns\":%llu}\n",
+           (s->at - s->m.started) / 1000000000LL, shm->tables, s->playing, s->players,
+           shm->slots, shm->min_players, shm->goal,
+           s->c.games_started, s->c.games_finished, s->c.turns, turn_rate, s->changes,
+           s->c.joins, s->m.join_refused, s->c.slot_full,
+           s->m.log_depth, s->ring_depth, s->ring_dropped,
+           s->c.lock_taken, s->c.lock_waits, s->c.lock_wait_ns);
+}
@@ -0,0 +1,899 @@
+// OS Assignment - dice game - game.h (shared by server.c and client.c)
+
+#ifndef GAME_H
+#define GAME_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define MXP 5 // MXP = default seats per table (--players)
+#define MXS 1024 // MXS = most seats one table can be given, at most 64 * 64 so one summary word covers the free map
+#define MNP 3 // MNP = default players a table waits for (--min)
+#define WC 20 // WC = default winning row (--goal)
+#define GM 1000 // GM = longest board --goal accepts
+#define MXT 64 // MXT = maximum tables one server can host
+#define FC -2 // FC = FW of a table whose game ended because everyone left, closed to joins until it is reset
+#define SHM_MAGIC 0x44494345 // "DICE", the server stores it last so a half set up segment is never used
+#define SHM_VERSION 6 // bump whenever ShmHeader or GameInfo change shape
+#define shm_name "/dice_game_shm"
+#define fifo_p "/tmp/player_" // fifo_p = fifo prefix, followed by <table>_<slot>_to_server / _from_server
+#define join_fifo "/tmp/dice_join" // join_fifo = well known FIFO clients announce themselves on
+#define lobby_p "/tmp/dice_lobby_" // lobby_p = prefix of the per client FIFO a lobby seat is sent back on
+#define sock_path "/tmp/dice_sock" // sock_path = SOCK_SEQPACKET listener of --socket servers
+
+#define LR 256 // LR = records in the shared log ring
+#define ER 1024 // ER = records in each table's event ring, a power of two
+#define FQ 16 // FQ = frames one read() of a player FIFO can pick up
+#define MB 8 // MB = frames one shared memory mailbox holds
+#define HS 4 // HS = sub-bucket bits, each power of two is split into 16 buckets (about 6% precision)
+#define HM 40 // HM = latencies at or above 2^HM ns (about 18 minutes) land in the last bucket
+#define HN ((HM - HS + 1) << HS) // HN = buckets per histogram
+
+// Frame types on the player FIFOs
+#define MT_ROLL 1 // client to server, roll for me
+#define MT_ROLLED 2 // server to client, payload = dice value
+
+// Phases of one turn, each gets its own histogram in ShmHeader
+#define PH_SEND 0 // client sent the ROLL -> handler read it
+#define PH_LOCK 1 // handler read it -> shm_lock acquired
+#define PH_MOVE 2 // lock acquired -> position updated
+#define PH_TURN 3 // position updated -> CT advanced
+#define PH_NOTIFY 4 // CT advanced -> next player's turn word bumped and woken
+#define PH_REPLY 5 // handler sent the ROLLED -> client read it
+#define PH_WAKE 6 // next player notified -> its client saw the turn
+#define PH_TOTAL 7 // whole ROLL -> ROLLED round trip at the client
+#define PHN 8 // PHN = number of phases
+
+// JoinMsg types
+#define JM_JOIN 0 // slot claimed and FIFOs created, start serving it
+#define JM_LOBBY 1 // no table chosen, seat me at one (reply goes to lobby_p<pid>)
+#define JM_WAKE 2 // from inside the server, only wakes main up
+
+// Event types in a table's event ring, arg depends on the type
+#define ET_JOIN 1 // player took a seat
+#define ET_LEAVE 2 // player left or was dropped
+#define ET_START 3 // game started, arg = players seated
+#define ET_ROLL 4 // arg = dice value
+#define ET_MOVE 5 // arg = new position
+#define ET_TURN 6 // turn handed to player, arg = round
+#define ET_WIN 7 // player reached the goal, arg = position
+#define ET_END 8 // server stopped the game, player = -1
+#define ET_RESET 9 // board cleared for the next game, player = -1
+
+// Records on join_fifo, and the seat reply sent back to a lobby client
+struct JoinMsg
+{
+    int type; // JM_JOIN, JM_LOBBY or JM_WAKE
+    int table; // table the slot belongs to, -1 in a reply means no seat
+    int slot;
+    pid_t pid; // must match slot_pid[slot] for JM_JOIN
+    char name[50]; // player name for JM_LOBBY
+};
+
+// One message on a player FIFO, fixed size so several fit in one read() or write()
+struct Frame
+{
+    unsigned char type; // MT_ROLL or MT_ROLLED
+    unsigned char payload; // dice value in a ROLLED
+    unsigned short seq; // seq = sender's counter, a reply echoes the seq of its request
+    unsigned int player; // slot the message is about
+    long long ts; // ts = CLOCK_MONOTONIC nanoseconds when the frame was sent
+};
+
+// Single producer single consumer ring of frames in shared memory, one per slot and direction (--mailbox)
+struct Mailbox
+{
+    unsigned int head __attribute__((aligned(64))); // head = frames ever sent, written by the producer only
+    unsigned int tail __attribute__((aligned(64))); // tail = frames ever taken, written by the consumer only
+    unsigned int sleeping; // consumer is about to sleep in fw(), only then does the producer pay for a wake-up
+    unsigned int ftx; // ftx = futex word the consumer sleeps on
+    struct Frame f[MB] __attribute__((aligned(64))); // producer writes, kept off the tail line the consumer writes
+};
+
+// Read side of a player FIFO, keeps a partial frame until the rest of it arrives
+struct FrameIn
+{
+    unsigned char buf[FQ * sizeof(struct Frame)];
+    size_t len;
+};
+
+// One fixed size line in the log ring
+struct LogRec
+{
+    unsigned int seq; // seq = position + 1 once published, position + LR once the logger consumed it
+    char line[244]; // the message as given, the logger adds the date and the newline
+    long long at; // at = CLOCK_REALTIME seconds when it was published
+};
+
+// One record in a table's event ring
+struct Event
+{
+    unsigned int seq; // seq = event number + 1 once written, 0 while ep() is filling it in
+    int type; // ET_*
+    int player; // slot the event is about
+    int arg;
+};
+
+// Lock-free log ring, forked handlers and signal handlers publish, the server logger drains it
+struct LogRing
+{
+    unsigned int head __attribute__((aligned(64))); // head = next position to reserve, producers CAS it
+    unsigned int dropped; // records thrown away because the ring was full
+    unsigned int tail __attribute__((aligned(64))); // tail = next position the logger reads, logger only
+    unsigned int ftx; // ftx = futex word the logger sleeps on, bumped after every publish
+    struct LogRec rec[LR] __attribute__((aligned(64)));
+};
+
+// Log-linear latency histogram, HDR style, updated with atomics by any process so no lock is needed
+struct Hist
+{
+    unsigned long long count;
+    unsigned long long sum; // sum = ns, for the mean
+    unsigned long long max;
+    unsigned long long b[HN]; // b = samples per bucket, see hb()
+};
+
+// Counters the server keeps for dice-stats, bumped with relaxed atomics, never read back by the game
+struct Metrics
+{
+    long long started; // started = mn() when the server came up, turns/sec is measured from here
+    unsigned long long join_refused; // join records or connections the server turned down
+    unsigned long long log_depth; // lines in the logger thread's queue, not written yet
+};
+
+// Counters of one table, a cache line in its GameInfo so busy tables never count on a shared line
+// dice-stats adds them up over all tables
+struct TableCounters
+{
+    unsigned long long games_started;
+    unsigned long long games_finished; // games that ended with a winner
+    unsigned long long turns; // rolls applied
+    unsigned long long joins; // players the server started serving
+    unsigned long long slot_full; // Fslot() of a client found no free slot here
+    unsigned long long lock_taken; // shm_lock acquisitions by the server
+    unsigned long long lock_waits; // acquisitions that found shm_lock held
+    unsigned long long lock_wait_ns; // time spent waiting for it
+};
+
+// Start of /dice_game_shm, the tables follow right after it
+struct ShmHeader
+{
+    unsigned int magic; // SHM_MAGIC once the server finished setting up the segment
+    unsigned int version; // SHM_VERSION of the server's game.h
+    unsigned int header_size; // sizeof(struct ShmHeader) in the server
+    unsigned int info_size; // sizeof(struct GameInfo) in the server
+    unsigned int table_size; // table_size = bytes per table, GameInfo plus its per slot arrays, see tz()
+    unsigned int slots; // slots = seats per table (--players)
+    int min_players; // players a table waits for before a game starts (--min)
+    int goal; // goal = row that wins the race (--goal)
+    int tables; // tables = number of GameInfo records in the segment
+    int continuous; // server resets each table and starts the next game instead of exiting
+    int mailbox; // players talk through the mailboxes in GameInfo instead of FIFOs
+    int socket; // players connect to sock_path instead of using FIFOs, the connection is the join
+    int stopping; // set on shutdown so clients waiting between games give up
+    struct LogRing log_ring;
+    struct Hist lat[PHN]; // lat = one histogram per turn phase, PH_*
+    struct Metrics metrics __attribute__((aligned(64)));
+} __attribute__((aligned(64)));
+
+// One cache line per slot, bumping one handler's turn word never disturbs another slot
+struct SlotLine
+{
+    unsigned int turn_ftx; // turn_ftx = futex word bumped when the turn is handed to this slot
+    int nx; // nx = next seated slot in turn order, the ring of seated slots only changes under shm_lock
+    int pv; // pv = previous seated slot
+} __attribute__((aligned(64)));
+
+// Game state of one table, grouped by who writes it so writers and pollers do not share cache lines.
+// The per slot arrays follow it in the segment, tz() lays them out and pp() .. mf() find them.
+struct GameInfo
+{
+    // hot: changes on every move under the seqlock, every client and handler of the table polls it
+    unsigned int gen __attribute__((aligned(64))); // gen = state version, +2 for every join, roll, turn, leave and game end, odd while a writer holding shm_lock is inside one
+    unsigned int state_ftx; // state_ftx = futex word bumped on every join, move, turn change and game end
+    unsigned int names; // names = bumped with every change to PN, gs() only copies the names when it moved
+    int game_active;
+    int CT; // CT = current turn
+    int CP; // CP = connected player
+    int FW; // FW = final winner, -1 while the table takes players, FC after an emptied game
+    int round;
+    int head; // head = seated slot that opens each round, -1 while nobody is seated
+    long long turn_ts; // turn_ts = mn() when the current turn was handed over, for PH_WAKE
+    unsigned int ev_head; // ev_head = events ever published on this table, only moves inside the seqlock
+
+    // every lock and unlock writes here, kept away from the lines readers poll
+    pthread_mutex_t shm_lock __attribute__((aligned(64)));
+
+    // claims and releases CAS the free map and update these, no lock taken
+    unsigned long long free_sum __attribute__((aligned(64))); // free_sum = bit w set while word w of the free map may have a free slot
+    int free_n; // free_n = slots whose bit is set in the free map
+
+    // cold: written on join, claim and reset only
+    int table_id __attribute__((aligned(64)));
+    int mnpr; // mnpr = min player require
+    int games; // games = finished games on this table, bumped by rg() once the table is ready again
+    int slots; // slots = seats at this table, the length of every per slot array
+    unsigned int o_pp; // o_* = byte offset of a per slot array from the start of this GameInfo
+    unsigned int o_tw;
+    unsigned int o_pa;
+    unsigned int o_sl;
+    unsigned int o_sp;
+    unsigned int o_pn;
+    unsigned int o_fm;
+    unsigned int o_mt;
+    unsigned int o_mf;
+    unsigned int o_ev;
+    pthread_mutex_t table_sync;
+
+    // counted on every lock and roll, off the cold line whose offsets every accessor reads
+    struct TableCounters counters __attribute__((aligned(64)));
+};
+
+_Static_assert(sizeof(struct SlotLine) == 64, "one slot per cache line");
+_Static_assert(sizeof(struct TableCounters) == 64, "table counters fill one line");
+_Static_assert(MXS <= 64 * 64, "free_sum has one bit per free map word");
+_Static_assert(sizeof(struct GameInfo) % 64 == 0, "every table starts on a cache line");
+_Static_assert(__builtin_offsetof(struct GameInfo, shm_lock) - __builtin_offsetof(struct GameInfo, gen) == 64, "hot fields fit one line");
+
+// pp = PP, player position, like every per slot array below it is indexed by slot
+static inline int *pp(struct GameInfo *g)
+{
+    return (int *)((char *)g + g->o_pp);
+}
+
+// tw = TWN, total winning
+static inline int *tw(struct GameInfo *g)
+{
+    return (int *)((char *)g + g->o_tw);
+}
+
+// pa = player_active
+static inline int *pa(struct GameInfo *g)
+{
+    return (int *)((char *)g + g->o_pa);
+}
+
+// sl = slot lines, turn word and turn ring links
+static inline struct SlotLine *sl(struct GameInfo *g)
+{
+    return (struct SlotLine *)((char *)g + g->o_sl);
+}
+
+// sp = slot_pid, pid of the client holding the slot, 0 when free
+static inline pid_t *sp(struct GameInfo *g)
+{
+    return (pid_t *)((char *)g + g->o_sp);
+}
+
+// pn = PN, player name
+static inline char (*pn(struct GameInfo *g))[50]
+{
+    return (char (*)[50])((char *)g + g->o_pn);
+}
+
+// fm = free map, one bit per slot, set while nobody holds the slot
+static inline unsigned long long *fm(struct GameInfo *g)
+{
+    return (unsigned long long *)((char *)g + g->o_fm);
+}
+
+// mt = mailbox to server, --mailbox only, client produces
+static inline struct Mailbox *mt(struct GameInfo *g)
+{
+    return (struct Mailbox *)((char *)g + g->o_mt);
+}
+
+// mf = mailbox from server, --mailbox only, handler produces
+static inline struct Mailbox *mf(struct GameInfo *g)
+{
+    return (struct Mailbox *)((char *)g + g->o_mf);
+}
+
+// er = event ring, ER records, ev_head picks the one written next
+static inline struct Event *er(struct GameInfo *g)
+{
+    return (struct Event *)((char *)g + g->o_ev);
+}
+
+// Consistent copy of the board a reader works from, vn() sizes it and gs() fills it
+struct View
+{
+    unsigned int gen; // gen the copy was taken at, always even once filled (start at 1 to force a copy)
+    unsigned int names; // names of the table the PN copy was taken at
+    int slots; // entries in each array below
+    int *PP;
+    int *TWN;
+    int *player_active;
+    int CT;
+    int game_active;
+    int CP;
+    int FW;
+    int round;
+    char (*PN)[50];
+    unsigned int ev; // ev = ev_head at the copy, every event before it is already in the board
+    unsigned int missed; // missed = changes that landed between two copies, this reader only saw where they ended
+};
+
+// ua = round a byte count up to whole cache lines
+static inline size_t ua(size_t n)
+{
+    return (n + 63) & ~(size_t)63;
+}
+
+// tz = table size, bytes one table with this many slots takes in the segment
+// with g it also records where each per slot array starts, PP, TWN and player_active back to back so gs() copies them at once
+static inline size_t tz(int slots, struct GameInfo *g)
+{
+    size_t o_pp;
+    size_t o_tw;
+    size_t o_pa;
+    size_t o_sl;
+    size_t o_sp;
+    size_t o_pn;
+    size_t o_fm;
+    size_t o_mt;
+    size_t o_mf;
+    size_t o_ev;
+    o_pp = sizeof(struct GameInfo);
+    o_tw = o_pp + slots * sizeof(int);
+    o_pa = o_tw + slots * sizeof(int);
+    o_sl = ua(o_pa + slots * sizeof(int));
+    o_sp = o_sl + slots * sizeof(struct SlotLine);
+    o_pn = ua(o_sp + slots * sizeof(pid_t));
+    o_fm = ua(o_pn + slots * 50);
+    o_mt = ua(o_fm + (slots + 63) / 64 * sizeof(unsigned long long));
+    o_mf = o_mt + slots * sizeof(struct Mailbox);
+    o_ev = ua(o_mf + slots * sizeof(struct Mailbox));
+
+    if (g != NULL)
+    {
+        g->slots = slots;
+        g->o_pp = o_pp;
+        g->o_tw = o_tw;
+        g->o_pa = o_pa;
+        g->o_sl = o_sl;
+        g->o_sp = o_sp;
+        g->o_pn = o_pn;
+        g->o_fm = o_fm;
+        g->o_mt = o_mt;
+        g->o_mf = o_mf;
+        g->o_ev = o_ev;
+    }
+    return o_ev + ER * sizeof(struct Event);
+}
+
+// shm_size = bytes needed for the header plus all tables
+static inline size_t shm_size(int tables, size_t table_size)
+{
+    return sizeof(struct ShmHeader) + (size_t)tables * table_size;
+}
+
+// lv = layout verify, 0 when the segment was laid out by a server built from this game.h
+// -1 while the server is still setting it up, -2 when the layouts differ
+static inline int lv(struct ShmHeader *hdr, size_t len)
+{
+    if (len < sizeof(struct ShmHeader) || __atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC)
+    {
+        return -1;
+    }
+
+    if (hdr->version != SHM_VERSION || hdr->header_size != sizeof(struct ShmHeader)
+        || hdr->info_size != sizeof(struct GameInfo) || hdr->slots < 1 || hdr->slots > MXS
+        || hdr->table_size != tz(hdr->slots, NULL) || len < shm_size(hdr->tables, hdr->table_size))
+    {
+        return -2;
+    }
+    return 0;
+}
+
+// tp = table pointer, the GameInfo of one table inside the mapped segment
+static inline struct GameInfo *tp(struct ShmHeader *hdr, int table)
+{
+    return (struct GameInfo *)((char *)(hdr + 1) + (size_t)table * hdr->table_size);
+}
+
+// vn = view new, allocates the arrays of a view for tables with this many slots, -1 when out of memory
+static inline int vn(struct View *v, int slots)
+{
+    v->gen = 1;
+    v->names = 0;
+    v->missed = 0;
+    v->slots = slots;
+    v->PP = calloc(3 * (size_t)slots, sizeof(int));
+    v->PN = calloc(slots, sizeof(*v->PN));
+    if (v->PP == NULL || v->PN == NULL)
+    {
+        return -1;
+    }
+    v->TWN = v->PP + slots;
+    v->player_active = v->TWN + slots;
+    return 0;
+}
+
+// fpath = FIFO path of one slot, dir is "to_server" or "from_server"
+static inline void fpath(char *buf, size_t n, int table, int slot, const char *dir)
+{
+    snprintf(buf, n, "%s%d_%d_%s", fifo_p, table, slot, dir);
+}
+
+// lpath = FIFO a lobby client waits on for its seat
+static inline void lpath(char *buf, size_t n, pid_t pid)
+{
+    snprintf(buf, n, "%s%d", lobby_p, (int)pid);
+}
+
+// wb = write begin, the caller holds shm_lock so writers never overlap, readers retry while gen is odd
+static inline void wb(struct GameInfo *g)
+{
+    __atomic_store_n(&g->gen, g->gen + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// we = write end, gen turns even again and readers may keep what they copy
+static inline void we(struct GameInfo *g)
+{
+    __atomic_store_n(&g->gen, g->gen + 1, __ATOMIC_RELEASE);
+}
+
+// gs = game snapshot, copies the board without taking shm_lock, retrying only while a writer is busy
+// returns 0 and copies nothing when gen still equals v->gen, so an unchanged board costs one load
+static inline int gs(struct GameInfo *g, struct View *v)
+{
+    while (1)
+    {
+        unsigned int before;
+        before = __atomic_load_n(&g->gen, __ATOMIC_ACQUIRE);
+
+        if (before == v->gen)
+        {
+            return 0;
+        }
+
+        if ((before & 1) == 0)
+        {
+            memcpy(v->PP, pp(g), 3 * v->slots * sizeof(int)); // PP, TWN and player_active
+            v->CT = g->CT;
+            v->game_active = g->game_active;
+            v->CP = g->CP;
+            v->FW = g->FW;
+            v->round = g->round;
+            v->ev = g->ev_head;
+
+            unsigned int names;
+            names = g->names;
+            if (names != v->names)
+            {
+                memcpy(v->PN, pn(g), v->slots * sizeof(*v->PN));
+            }
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&g->gen, __ATOMIC_RELAXED) == before)
+            {
+                // every change moves gen by 2, a bigger step means some were never seen on their own
+                if ((v->gen & 1) == 0 && before - v->gen > 2)
+                {
+                    v->missed = v->missed + (before - v->gen) / 2 - 1;
+                }
+                v->gen = before;
+                v->names = names;
+                return 1;
+            }
+        }
+        sched_yield();
+    }
+}
+
+// ep = event publish, the caller holds shm_lock and is between wb() and we(), so a snapshot's ev
+// always matches its board and there is only ever one writer per ring
+static inline void ep(struct GameInfo *g, int type, int player, int arg)
+{
+    unsigned int n;
+    n = g->ev_head;
+
+    struct Event *e;
+    e = &er(g)[n & (ER - 1)];
+
+    // readers still on the record this one laps see seq change and give up on it
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->type = type;
+    e->player = player;
+    e->arg = arg;
+    __atomic_store_n(&e->seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g->ev_head, n + 1, __ATOMIC_RELEASE);
+}
+
+// et = event take, copies event *at and moves *at on, no lock and nothing written to the segment
+// 1 = got one, 0 = nothing new yet, -1 = the ring lapped *at, resync from a snapshot's ev
+static inline int et(struct GameInfo *g, unsigned int *at, struct Event *out)
+{
+    unsigned int head;
+    head = __atomic_load_n(&g->ev_head, __ATOMIC_ACQUIRE);
+
+    if (head == *at)
+    {
+        return 0;
+    }
+    if (head - *at > ER)
+    {
+        return -1;
+    }
+
+    struct Event *e;
+    e = &er(g)[*at & (ER - 1)];
+
+    // the record was complete before head passed it, only a writer a whole lap ahead can change it now
+    if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != *at + 1)
+    {
+        return -1;
+    }
+    out->type = e->type;
+    out->player = e->player;
+    out->arg = e->arg;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != *at + 1)
+    {
+        return -1;
+    }
+
+    out->seq = *at + 1;
+    *at = *at + 1;
+    return 1;
+}
+
+// mn = monotonic now in nanoseconds
+static inline long long mn(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// hb = histogram bucket of a latency in ns, exact below 16 ns, then 16 buckets per power of two
+static inline int hb(long long v)
+{
+    if (v < (1 << HS))
+    {
+        return v < 0 ? 0 : (int)v;
+    }
+
+    int msb;
+    msb = 63 - __builtin_clzll((unsigned long long)v);
+    if (msb >= HM)
+    {
+        return HN - 1;
+    }
+
+    int shift;
+    shift = msb - HS;
+    return ((shift + 1) << HS) + (int)((v >> shift) & ((1 << HS) - 1));
+}
+
+// hv = highest latency that still falls into bucket i
+static inline long long hv(int i)
+{
+    if (i < (1 << HS))
+    {
+        return i;
+    }
+
+    int shift;
+    shift = (i >> HS) - 1;
+    return ((long long)((1 << HS) + (i & ((1 << HS) - 1)) + 1) << shift) - 1;
+}
+
+// hr = histogram record, lock-free so forked handlers, threads and clients can all add samples
+static inline void hr(struct Hist *h, long long v)
+{
+    if (v < 0)
+    {
+        v = 0;
+    }
+
+    __atomic_add_fetch(&h->b[hb(v)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->sum, (unsigned long long)v, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->count, 1, __ATOMIC_RELAXED);
+
+    unsigned long long seen;
+    seen = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while ((unsigned long long)v > seen
+           && __atomic_compare_exchange_n(&h->max, &seen, (unsigned long long)v, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == 0)
+    {
+    }
+}
+
+// hp = histogram percentile, q between 0 and 1, answers with the top of the bucket it falls in
+static inline long long hp(const struct Hist *h, double q)
+{
+    unsigned long long count;
+    count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    unsigned long long want;
+    want = (unsigned long long)(q * count);
+    if (want >= count)
+    {
+        want = count - 1;
+    }
+
+    unsigned long long seen;
+    seen = 0;
+
+    int i;
+    for (i = 0; i < HN; i = i + 1)
+    {
+        seen = seen + __atomic_load_n(&h->b[i], __ATOMIC_RELAXED);
+        if (seen > want)
+        {
+            break;
+        }
+    }
+
+    // a bucket never reports more than the real maximum
+    long long top;
+    top = hv(i < HN ? i : HN - 1);
+    if ((unsigned long long)top > h->max)
+    {
+        top = h->max;
+    }
+    return top;
+}
+
+// fo = frames out, sends n frames with a single write(), all or nothing under PIPE_BUF
+static inline int fo(int fd, const struct Frame *f, int n)
+{
+    ssize_t written;
+    written = write(fd, f, n * sizeof(struct Frame));
+    return written == (ssize_t)(n * sizeof(struct Frame)) ? 0 : -1;
+}
+
+// fi = frames in, appends whatever the FIFO holds to in, returns what read() returned
+static inline ssize_t fi(int fd, struct FrameIn *in)
+{
+    ssize_t bytes_read;
+    bytes_read = read(fd, in->buf + in->len, sizeof(in->buf) - in->len);
+    if (bytes_read > 0)
+    {
+        in->len = in->len + bytes_read;
+    }
+    return bytes_read;
+}
+
+// fx = frame extract, takes the oldest whole frame out of in, returns 0 when none is complete yet
+static inline int fx(struct FrameIn *in, struct Frame *f)
+{
+    if (in->len < sizeof(struct Frame))
+    {
+        return 0;
+    }
+    memcpy(f, in->buf, sizeof(struct Frame));
+    in->len = in->len - sizeof(struct Frame);
+    memmove(in->buf, in->buf + sizeof(struct Frame), in->len);
+    return 1;
+}
+
+// fw = futex wait, sleeps while *addr still holds val (returns early on wake-up or signal)
+static inline int fw(unsigned int *addr, unsigned int val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+// fwk = futex wake, wakes up to n processes sleeping on addr
+static inline int fwk(unsigned int *addr, int n)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAKE, n, NULL, NULL, 0);
+}
+
+// fb = futex bump, changes the word so sleepers do not miss the update, then wakes them
+static inline void fb(unsigned int *addr, int n)
+{
+    __atomic_add_fetch(addr, 1, __ATOMIC_RELEASE);
+    fwk(addr, n);
+}
+
+// ms = mailbox send, returns -1 when the consumer is MB frames behind
+static inline int ms(struct Mailbox *m, const struct Frame *f)
+{
+    unsigned int head;
+    head = m->head;
+
+    if (head - __atomic_load_n(&m->tail, __ATOMIC_ACQUIRE) == MB)
+    {
+        return -1;
+    }
+
+    m->f[head % MB] = *f;
+    __atomic_store_n(&m->head, head + 1, __ATOMIC_RELEASE);
+
+    // pairs with the fence in mr(), either we see sleeping or the consumer sees the new head
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m->sleeping, __ATOMIC_RELAXED) == 1)
+    {
+        fb(&m->ftx, 1);
+    }
+    return 0;
+}
+
+// mr = mailbox receive, takes the oldest frame, sleeping up to timeout (NULL = forever) when empty
+// returns 0 when nothing arrived, also after a wake-up that was not a frame (game end, shutdown)
+static inline int mr(struct Mailbox *m, struct Frame *f, const struct timespec *timeout)
+{
+    unsigned int tail;
+    tail = m->tail;
+
+    if (__atomic_load_n(&m->head, __ATOMIC_ACQUIRE) == tail)
+    {
+        unsigned int seen;
+        seen = __atomic_load_n(&m->ftx, __ATOMIC_ACQUIRE);
+
+        __atomic_store_n(&m->sleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&m->head, __ATOMIC_ACQUIRE) == tail)
+        {
+            fw(&m->ftx, seen, timeout);
+        }
+        __atomic_store_n(&m->sleeping, 0, __ATOMIC_RELAXED);
+
+        if (__atomic_load_n(&m->head, __ATOMIC_ACQUIRE) == tail)
+        {
+            return 0;
+        }
+    }
+
+    *f = m->f[tail % MB];
+    __atomic_store_n(&m->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// fe = free map word empty, drops word w from free_sum, then puts it back if a release refilled it meanwhile
+static inline void fe(struct GameInfo *g, int w)
+{
+    __atomic_and_fetch(&g->free_sum, ~(1ULL << w), __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&fm(g)[w], __ATOMIC_SEQ_CST) != 0)
+    {
+        __atomic_or_fetch(&g->free_sum, 1ULL << w, __ATOMIC_SEQ_CST);
+    }
+}
+
+// fc = free claim, takes the lowest free slot off the free map with one CAS, -1 when none is left
+// find-first-set on free_sum picks the word, find-first-set on the word picks the slot
+static inline int fc(struct GameInfo *g)
+{
+    unsigned long long *map;
+    map = fm(g);
+
+    while (1)
+    {
+        unsigned long long sum;
+        sum = __atomic_load_n(&g->free_sum, __ATOMIC_ACQUIRE);
+        if (sum == 0)
+        {
+            return -1;
+        }
+
+        int w;
+        w = __builtin_ctzll(sum);
+
+        unsigned long long word;
+        word = __atomic_load_n(&map[w], __ATOMIC_ACQUIRE);
+        while (word != 0)
+        {
+            int bit;
+            bit = __builtin_ctzll(word);
+
+            // a failed CAS reloads word, another claimer won that bit so try the next one
+            if (__atomic_compare_exchange_n(&map[w], &word, word & ~(1ULL << bit), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                __atomic_sub_fetch(&g->free_n, 1, __ATOMIC_RELAXED);
+                if ((word & ~(1ULL << bit)) == 0)
+                {
+                    fe(g, w);
+                }
+                return w * 64 + bit;
+            }
+        }
+
+        // free_sum is only a hint, this word emptied since it was set
+        fe(g, w);
+    }
+}
+
+// fr = free release, gives a slot back to the free map, releasing a slot that is already free changes nothing
+static inline void fr(struct GameInfo *g, int slot)
+{
+    unsigned long long bit;
+    bit = 1ULL << (slot % 64);
+
+    if ((__atomic_fetch_or(&fm(g)[slot / 64], bit, __ATOMIC_SEQ_CST) & bit) == 0)
+    {
+        __atomic_add_fetch(&g->free_n, 1, __ATOMIC_RELAXED);
+        __atomic_or_fetch(&g->free_sum, 1ULL << (slot / 64), __ATOMIC_SEQ_CST);
+    }
+}
+
+// fa = free all, every slot of the table free again, caller holds shm_lock and nobody plays at the table
+static inline void fa(struct GameInfo *g)
+{
+    int words;
+    words = (g->slots + 63) / 64;
+
+    int w;
+    for (w = 0; w < words; w = w + 1)
+    {
+        int left;
+        left = g->slots - w * 64;
+        __atomic_store_n(&fm(g)[w], left >= 64 ? ~0ULL : (1ULL << left) - 1, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&g->free_n, g->slots, __ATOMIC_RELAXED);
+    __atomic_store_n(&g->free_sum, words == 64 ? ~0ULL : (1ULL << words) - 1, __ATOMIC_RELEASE);
+}
+
+// cl = claim a free slot of a table for pid, returns the slot or -1 when the table is full
+// or its game just ended and it has not been reset yet
+// lock-free: the CAS in fc() is the claim, pid and name are published right after it and the server
+// sees the seat taken at once; only a full table that still has unjoined claims takes shm_lock to reclaim dead ones
+static inline int cl(struct GameInfo *g, pid_t pid, const char *name)
+{
+    if (__atomic_load_n(&g->FW, __ATOMIC_ACQUIRE) != -1)
+    {
+        return -1;
+    }
+
+    int available_slot;
+    available_slot = fc(g);
+
+    if (available_slot == -1 && __atomic_load_n(&g->CP, __ATOMIC_RELAXED) < g->slots)
+    {
+        pthread_mutex_lock(&g->shm_lock);
+
+        int *player_active;
+        pid_t *slot_pid;
+        player_active = pa(g);
+        slot_pid = sp(g);
+
+        int i;
+        for (i = 0; i < g->slots; i = i + 1)
+        {
+            // a claim whose client died before joining is free again
+            pid_t holder;
+            holder = __atomic_load_n(&slot_pid[i], __ATOMIC_ACQUIRE);
+            if (holder != 0 && player_active[i] == 0 && kill(holder, 0) == -1 && errno == ESRCH
+                && __atomic_compare_exchange_n(&slot_pid[i], &holder, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                fr(g, i);
+            }
+        }
+        pthread_mutex_unlock(&g->shm_lock);
+
+        available_slot = fc(g);
+    }
+
+    if (available_slot == -1)
+    {
+        return -1;
+    }
+
+    // PN first, a reader that sees names move or the slot go active also sees the whole name
+    strncpy(pn(g)[available_slot], name, 49);
+    pn(g)[available_slot][49] = '\0';
+    __atomic_store_n(&sp(g)[available_slot], pid, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&g->names, 1, __ATOMIC_RELEASE);
+    fb(&g->state_ftx, INT_MAX);
+    return available_slot;
+}
+
+#endif
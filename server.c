@@ -1,5 +1,6 @@
 // OS Assignment - dice game - server.c
 
+#define _GNU_SOURCE // struct ucred for SO_PEERCRED
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,56 +13,124 @@
 #include <signal.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "game.h"
 
 // setting: min 3 players, and max 5 players, the first player race to R20 will be the winner, each player uses unique FIFO path
-#define MXP 5 // MXP = maximum 5 player
-#define MNP 3 // MNP = minimum 3 player 
-#define wc 20 // win condition when players reaches R20 first 
-#define fifo_p "/tmp/player_"
+// (the defaults, --min, --players and --goal change them for the whole server)
 #define log "game.log"
-#define srocesf "scores.txt"
+#define srocesf "scores.txt" // text export of scores_db, rewritten after every game
+#define scores_db "scores.db" // binary scoreboard, one record per player name, shared by all tables
+#define SB_N 65536 // SB_N = records in scores_db, a power of two, new names stop at 3/4 full so probes stay short
+#define SB_MAGIC 0x53434f52 // "SCOR"
+#define SB_VERSION 1
+#define LQ 1024 // LQ = most clients the lobby holds at once
+#define HQ 64 // HQ = most socket connections waiting for their first packet at once
+#define HW 1000 // HW = ms a new connection gets to send its first packet
+#define EV 64 // EV = epoll events one wait hands back, more ready players come with the next wait
 
 // Structure for log messages queue
 struct LogNode 
 {
-    char message[256];
+    char message[512]; // already formatted line, timestamp and newline included
     struct LogNode *next;
 };
 
-// Queue for logger thread
+// Queue for logger thread, threads of the main process only (forked handlers use the shm log ring)
 struct LogQueue 
 {
     struct LogNode *head;
     struct LogNode *tail;
     pthread_mutex_t mutex;
-    pthread_cond_t cond;
 };
 
 struct LogQueue log_queue;
 
-// Main game state structure
-struct GameInfo 
-{
-    int PP[MXP]; //PP = player position 
-    int CT; // CT = current turn
-    int game_active;
-    int CP; // CP = connected player 
-    int player_active[MXP];
-    int FW; // FW = final winner 
-    int round; 
-    char PN[MXP][50]; //PN = player name
-    int TWN[MXP]; //TWN = total winning
-    pthread_mutex_t shm_lock;
-    pthread_mutex_t table_sync;
-    int mnpr; // mnpr = min player require
+// Per table bookkeeping that only the server process needs
+struct Table
+{
+    struct GameInfo *g; // g = the table's state in shared memory
+    pthread_t thread; // thread running rt() for this table
+    pid_t *child_pids; // per slot arrays below are allocated by intg() once mxp is known
+    int child_count_total;
+    int epoll_fd; // epoll mode only
+    int *ep_read; // ep_read = player to server FIFO per slot, epoll mode only (the socket with --socket)
+    int *ep_write; // ep_write = server to player FIFO per slot, opened on the first ROLL (same socket with --socket)
+    struct FrameIn *ep_in; // ep_in = frames read from ep_read but not handled yet
+    int done; // game over, the lobby stops seating here
+};
+
+// A socket connection accepted but whose JoinMsg has not arrived yet
+struct Hello
+{
+    int fd;
+    long long since; // since = mn() when it was accepted
+};
+
+// A client waiting in the lobby for a seat
+struct Lobby
+{
+    pid_t pid;
+    char name[50];
+};
+
+// Start of scores_db, SB_N records follow it
+struct ScoreHead
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int cap; // cap = records in the file
+    unsigned int used; // used = names stored
+} __attribute__((aligned(64)));
+
+// One player in scores_db, a cache line each, found by open addressing on nh() of the name
+struct ScoreRec
+{
+    unsigned int key; // key = nh() of name, 0 while the record is free
+    int wins; // updated in place with one atomic add, a crash never leaves half a count
+    char name[56];
 };
 
-struct GameInfo *gptr = NULL; // gptr = game pointer
+// One line of the text export
+struct ScoreRow
+{
+    char name[56];
+    int wins;
+};
+
+struct ShmHeader *shm = NULL; // shm = whole mapped segment
+__thread struct GameInfo *gptr = NULL; // gptr = game pointer of the table this thread (or forked handler) serves
+__thread struct Table *tptr = NULL; // tptr = local bookkeeping for the same table
+struct Table tables[MXT];
+int table_count = 1; // --tables N
+int mxp = MXP; // mxp = seats per table, --players N
+int mnp = MNP; // mnp = players a table waits for before its first game, --min N
+int wc = WC; // wc = win condition, the row a player has to reach first, --goal N
+int tables_done = 0; // tables whose game is over, main exits when all are
 int shared_mem_fd;
 pthread_t logger_thread, scheduler_thread;
 volatile sig_atomic_t server_running = 1;
-pid_t child_pids[MXP];
-int child_count_total = 0;
+int join_fd = -1; // join_fd = read end of join_fifo, opened O_RDWR so it never reports EOF
+int stop_pipe[2]; // stop_pipe = written once on shutdown so handlers blocked in poll() wake up
+int epoll_mode = 0; // --epoll: serve every player from one event loop per table instead of forking hd()
+int continuous_mode = 0; // --continuous: reset each table after its game and play again, never exit on our own
+int mailbox_mode = 0; // --mailbox: players use the shared memory mailboxes instead of FIFOs
+int socket_mode = 0; // --socket: players connect to sock_path instead of using FIFOs
+int listen_fd = -1; // listen_fd = SOCK_SEQPACKET listener, socket mode only
+int log_fd = -1; // log_fd = game.log, opened once with O_APPEND, only ltf() writes it
+pid_t server_pid; // server_pid = main process, forked handlers cannot use log_queue
+int log_stop = 0; // set by main once every table is finished, the logger drains and exits
+volatile sig_atomic_t dump_req = 0; // dump_req = SIGUSR1 asked for a latency dump, the logger prints it
+struct Lobby lobby[LQ]; // lobby = clients that asked to be seated, oldest first, only main touches it
+int lobby_count = 0;
+struct Hello hello[HQ]; // hello = connections waiting for their first packet, oldest first, only main touches it
+int hello_count = 0;
+struct ScoreHead *sb = NULL; // sb = scores_db mapped, NULL keeps wins in memory only (per slot, like before)
+size_t sb_len = 0;
+pthread_mutex_t score_lock = PTHREAD_MUTEX_INITIALIZER; // score_lock = adding names and copying the board out, server process only
 
 // Function declarations
 void ssm(); // ssm = setting share memeory 
@@ -71,115 +140,487 @@ void *stf(void *arg); // stf = schedular thread function
 void hd(int player_id); // hd = handler player 
 void sigchld_handler(int sig);
 void sigint_handler(int sig);
+void sigusr1_handler(int sig);
+void ld(); // ld = latency dump, one line per turn phase
+void lk(struct GameInfo *g); // lk = lock shm_lock, counting contention for dice-stats
+void mc(unsigned long long *counter, long long n); // mc = metrics count
 void log_message(const char *message);
-void intg(); // intg = intialising game 
+void lp(const char *message); // lp = log publish, lock-free into the shm log ring for handlers and signal handlers
+int lr(char *batch, size_t n, size_t *used); // lr = log ring drain, returns records taken
+void lf(char *buf, size_t n, const char *message, time_t at); // lf = log format, date one line, at = when it happened
+void intg(int table); // intg = intialising game 
+void *tt(void *arg); // tt = table thread
+void rt(); // rt = run table, one game from lobby to final standings
 void rg(); //rg = reset game 
 void ls(); // ls = loading sccros 
 void ss(); //ss = saves scors
+unsigned int nh(const char *name); // nh = name hash
+struct ScoreRec *sk(const char *name, int add); // sk = score key, the record of one player
+int sq(const void *a, const void *b); // sq = score compare for qsort, most wins first
+int nt(); // nt = next turn
+void ri(int player_id); // ri = ring insert, player joins the turn order
+void ru(int player_id); // ru = ring unlink, player leaves the turn order
+int ar(int player_id, int dice_value, long long read_at); // ar = apply roll, read_at = when the ROLL was read
+void dp(int player_id); // dp = drop player
+void wj(); // wj = wait for join requests
+void rj(); // rj = read join requests
+void aj(int player_id); // aj = accept join
+void ac(); // ac = accept connections on the socket listener
+void hj(int i); // hj = hello join, read the first packet of a waiting connection
+void hx(); // hx = hello expire
+void el(); // el = event loop (epoll mode)
+void wa(struct GameInfo *g); // wa = wake all handlers of a table
+void ge(); // ge = game end, stop the running game of this table on shutdown
+int ro(int player_id, const struct Frame *request, struct Frame *reply); // ro = roll, answer one request frame
+void rn(int player_id, const struct Frame *reply, const char *tag); // rn = roll notes, log and print a roll once its reply is sent
+void mm(); // mm = matchmake, seat lobby clients at tables
+int st(int table); // st = seat lobby clients at a table until it is full
+void sr(pid_t pid, int table, int slot); // sr = send a seat reply to a lobby client
 
-// Load previous scores from file
+// Map scores_db, the file is the index so nothing is parsed or rebuilt however long its history
 void ls() 
 {
-    FILE *fptr; // fptr = file pointer 
-    fptr = fopen(srocesf, "r");
-    
-    if (fptr == NULL) 
+    size_t len;
+    len = sizeof(struct ScoreHead) + (size_t)SB_N * sizeof(struct ScoreRec);
+
+    int fd;
+    fd = open(scores_db, O_RDWR);
+
+    if (fd == -1 && errno == ENOENT)
     {
-        printf("[SERVER] No previous scores file found\n");
-        printf("[SERVER] Starting with fresh scores\n");
-        int i;
-        for (i = 0; i < MXP; i = i + 1) 
+        // build an empty board under another name and rename it into place, a crash never leaves half of one
+        struct ScoreHead head;
+        memset(&head, 0, sizeof(head));
+        head.magic = SB_MAGIC;
+        head.version = SB_VERSION;
+        head.cap = SB_N;
+
+        fd = open(scores_db ".tmp", O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1 || ftruncate(fd, len) == -1 || pwrite(fd, &head, sizeof(head), 0) != sizeof(head)
+            || fsync(fd) == -1 || rename(scores_db ".tmp", scores_db) == -1)
+        {
+            perror("[SERVER] Cannot create " scores_db);
+            if (fd != -1)
+            {
+                close(fd);
+                unlink(scores_db ".tmp");
+                fd = -1;
+            }
+        }
+        else
         {
-            gptr->TWN[i] = 0;
+            printf("[SERVER] No previous scores file found, created %s\n", scores_db);
         }
+    }
+
+    if (fd == -1)
+    {
+        printf("[SERVER] Scores are kept in memory only\n");
         return;
     }
 
-    printf("[SERVER] Loading scores from file...\n");
-    char line_buffer[256];
-    
-    while (fgets(line_buffer, sizeof(line_buffer), fptr) != NULL) 
+    struct stat st;
+    void *map;
+    map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == len)
+    {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (map == MAP_FAILED || ((struct ScoreHead *)map)->magic != SB_MAGIC
+        || ((struct ScoreHead *)map)->version != SB_VERSION || ((struct ScoreHead *)map)->cap != SB_N)
+    {
+        fprintf(stderr, "[SERVER] %s is damaged or from another version, scores are kept in memory only\n", scores_db);
+        if (map != MAP_FAILED)
+        {
+            munmap(map, len);
+        }
+        return;
+    }
+
+    sb = map;
+    sb_len = len;
+    printf("[SERVER] Loaded %s, %u players on record\n", scores_db, sb->used);
+}
+
+// FNV-1a, 0 is kept for free records
+unsigned int nh(const char *name)
+{
+    unsigned int h;
+    h = 2166136261u;
+
+    int i;
+    for (i = 0; name[i] != '\0'; i = i + 1)
+    {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+
+    if (h == 0)
+    {
+        h = 1;
+    }
+    return h;
+}
+
+// NULL when there is no scoreboard, the name is unknown and add is 0, or the board is full
+// lookups take no lock, forked handlers make them too; only server threads add, under score_lock
+// a new record gets its name before its key, so it is either free or complete, even after a crash
+struct ScoreRec *sk(const char *name, int add)
+{
+    if (sb == NULL || name[0] == '\0')
+    {
+        return NULL;
+    }
+
+    struct ScoreRec *rec;
+    rec = (struct ScoreRec *)(sb + 1);
+
+    unsigned int key;
+    key = nh(name);
+
+    int locked;
+    locked = 0;
+
+    unsigned int i;
+    i = key & (SB_N - 1);
+
+    unsigned int probes;
+    probes = 0;
+
+    while (probes < SB_N)
     {
-        if (strstr(line_buffer, "Slot") != NULL) 
+        unsigned int k;
+        k = __atomic_load_n(&rec[i].key, __ATOMIC_ACQUIRE);
+
+        if (k == key && strcmp(rec[i].name, name) == 0)
+        {
+            break;
+        }
+
+        if (k == 0)
         {
-            if (strstr(line_buffer, "|") != NULL) 
+            if (add == 0)
             {
-                int slot_n; // slot_n = slot number
-                int wins;
-                int result;
-                result = sscanf(line_buffer, "| Slot %d | %d", &slot_n, &wins);
-                
-                if (result == 2) 
-                {
-                    if (slot_n >= 1 && slot_n <= MXP) 
-                    {
-                        gptr->TWN[slot_n - 1] = wins;
-                        printf("   Loaded Slot %d: %d wins\n", slot_n, wins);
-                    }
-                }
+                return NULL;
+            }
+
+            // another table may be adding the same name right now, look again holding the lock
+            if (locked == 0)
+            {
+                pthread_mutex_lock(&score_lock);
+                locked = 1;
+                i = key & (SB_N - 1);
+                probes = 0;
+                continue;
+            }
+
+            if (sb->used >= SB_N / 4 * 3)
+            {
+                pthread_mutex_unlock(&score_lock);
+                return NULL;
             }
+
+            strncpy(rec[i].name, name, sizeof(rec[i].name) - 1);
+            rec[i].name[sizeof(rec[i].name) - 1] = '\0';
+            rec[i].wins = 0;
+            __atomic_store_n(&rec[i].key, key, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&sb->used, 1, __ATOMIC_RELAXED);
+            break;
         }
+
+        i = (i + 1) & (SB_N - 1);
+        probes = probes + 1;
     }
 
-    fclose(fptr);
-    printf("[SERVER] Score loading complete\n");
+    if (locked == 1)
+    {
+        pthread_mutex_unlock(&score_lock);
+    }
+    if (probes == SB_N)
+    {
+        return NULL;
+    }
+    return &rec[i];
 }
 
-// Save current scores to file
+int sq(const void *a, const void *b)
+{
+    const struct ScoreRow *x;
+    const struct ScoreRow *y;
+    x = a;
+    y = b;
+    if (x->wins != y->wins)
+    {
+        return y->wins - x->wins;
+    }
+    return strcmp(x->name, y->name);
+}
+
+// Export the scoreboard as scores.txt and push it to disk, the game just ended so no win may be lost now
+// the text is written aside and renamed into place, a reader never sees half of it
 void ss() 
 {
-    pthread_mutex_lock(&gptr->shm_lock);
-    
+    // who played at this table, copied under shm_lock, the files are written without it
+    struct ScoreRow *session;
+    session = malloc(mxp * sizeof(struct ScoreRow));
+    if (session == NULL)
+    {
+        perror("Error saving scores");
+        return;
+    }
+
+    int played;
+    played = 0;
+
+    // no scores_db: this table's wins per slot, like before
+    int *slot_wins;
+    slot_wins = NULL;
+    if (sb == NULL)
+    {
+        slot_wins = malloc(mxp * sizeof(int));
+        if (slot_wins == NULL)
+        {
+            perror("Error saving scores");
+            free(session);
+            return;
+        }
+    }
+
+    lk(gptr);
+    int i;
+    for (i = 0; i < mxp; i = i + 1) 
+    {
+        if (strlen(pn(gptr)[i]) > 0) 
+        {
+            snprintf(session[played].name, sizeof(session[played].name), "%s", pn(gptr)[i]);
+            session[played].wins = tw(gptr)[i];
+            played = played + 1;
+        }
+        if (slot_wins != NULL)
+        {
+            slot_wins[i] = tw(gptr)[i];
+        }
+    }
+    pthread_mutex_unlock(&gptr->shm_lock);
+
+    struct ScoreRow *rows;
+    int count;
+    rows = NULL;
+    count = 0;
+
+    if (sb != NULL)
+    {
+        msync(sb, sb_len, MS_SYNC);
+
+        // only the copy is made under score_lock, aj() adds new names under it on the main thread
+        pthread_mutex_lock(&score_lock);
+        rows = malloc((sb->used + 1) * sizeof(struct ScoreRow));
+
+        struct ScoreRec *rec;
+        rec = (struct ScoreRec *)(sb + 1);
+        for (i = 0; rows != NULL && i < SB_N && count < (int)sb->used; i = i + 1)
+        {
+            if (__atomic_load_n(&rec[i].key, __ATOMIC_ACQUIRE) != 0)
+            {
+                memcpy(rows[count].name, rec[i].name, sizeof(rows[count].name));
+                rows[count].wins = __atomic_load_n(&rec[i].wins, __ATOMIC_RELAXED);
+                count = count + 1;
+            }
+        }
+        pthread_mutex_unlock(&score_lock);
+
+        qsort(rows, count, sizeof(struct ScoreRow), sq);
+    }
+
+    // every table writes its own temporary file, the last rename wins and each one is a whole table
+    char score_file[64];
+    char tmp_file[80];
+    if (sb == NULL && gptr->table_id != 0)
+    {
+        snprintf(score_file, sizeof(score_file), "scores_%d.txt", gptr->table_id);
+    }
+    else
+    {
+        snprintf(score_file, sizeof(score_file), "%s", srocesf);
+    }
+    snprintf(tmp_file, sizeof(tmp_file), "%s.%d.tmp", score_file, gptr->table_id);
+
     FILE *fptr;
-    fptr = fopen(srocesf, "w");
+    fptr = fopen(tmp_file, "w");
     
     if (fptr == NULL) 
     {
         perror("Error saving scores");
-        pthread_mutex_unlock(&gptr->shm_lock);
+        free(rows);
+        free(slot_wins);
+        free(session);
         return;
     }
     
     fprintf(fptr, "======================================\n");
     fprintf(fptr, "|   Dice Game Score Statistics       |\n");
     fprintf(fptr, "======================================\n");
-    fprintf(fptr, "| %-20s | %-10s |\n", "Slot", "Total Wins");
-    fprintf(fptr, "======================================\n");
 
-    int i;
-    for (i = 0; i < MXP; i = i + 1) 
+    if (slot_wins != NULL)
+    {
+        fprintf(fptr, "| %-20s | %-10s |\n", "Slot", "Total Wins");
+        fprintf(fptr, "======================================\n");
+
+        for (i = 0; i < mxp; i = i + 1) 
+        {
+            fprintf(fptr, "| Slot %-16d | %-10d |\n", i + 1, slot_wins[i]);
+        }
+    }
+    else
     {
-        fprintf(fptr, "| Slot %-16d | %-10d |\n", i + 1, gptr->TWN[i]);
+        fprintf(fptr, "| %-20s | %-10s |\n", "Player", "Total Wins");
+        fprintf(fptr, "======================================\n");
+
+        for (i = 0; i < count; i = i + 1) 
+        {
+            fprintf(fptr, "| %-20s | %-10d |\n", rows[i].name, rows[i].wins);
+        }
     }
     
     fprintf(fptr, "======================================\n");
-    fprintf(fptr, "\nCurrent Game Session:\n");
+    fprintf(fptr, "\nLast Game Session (table %d):\n", gptr->table_id);
     
-    for (i = 0; i < MXP; i = i + 1) 
+    for (i = 0; i < played; i = i + 1) 
     {
-        if (strlen(gptr->PN[i]) > 0) 
-        {
-            fprintf(fptr, "  Slot %d: %s (%d wins)\n", 
-                    i + 1, gptr->PN[i], gptr->TWN[i]);
-        }
+        fprintf(fptr, "  %s (%d wins)\n", session[i].name, session[i].wins);
     }
     
+    fflush(fptr);
+    fsync(fileno(fptr));
     fclose(fptr);
-    printf("[SERVER] Scores saved to %s\n", srocesf);
+
+    if (rename(tmp_file, score_file) == -1)
+    {
+        perror("Error saving scores");
+        unlink(tmp_file);
+    }
+    else if (slot_wins != NULL)
+    {
+        printf("[SERVER] Scores saved to %s\n", score_file);
+    }
+    else
+    {
+        printf("[SERVER] Scores saved to %s (%d players on record)\n", score_file, count);
+    }
     
-    pthread_mutex_unlock(&gptr->shm_lock);
+    free(rows);
+    free(slot_wins);
+    free(session);
 }
 
-int main() 
+int main(int argc, char *argv[]) 
 {
+    int min_set; // min_set = --min was given, otherwise a small --players also lowers the minimum
+    min_set = 0;
+
+    int a;
+    for (a = 1; a < argc; a = a + 1)
+    {
+        if (strcmp(argv[a], "--epoll") == 0 || strcmp(argv[a], "-e") == 0)
+        {
+            epoll_mode = 1;
+        }
+        else if (strcmp(argv[a], "--continuous") == 0 || strcmp(argv[a], "-c") == 0)
+        {
+            continuous_mode = 1;
+        }
+        else if (strcmp(argv[a], "--mailbox") == 0 || strcmp(argv[a], "-m") == 0)
+        {
+            mailbox_mode = 1;
+        }
+        else if (strcmp(argv[a], "--socket") == 0 || strcmp(argv[a], "-s") == 0)
+        {
+            socket_mode = 1;
+        }
+        else if ((strcmp(argv[a], "--tables") == 0 || strcmp(argv[a], "-t") == 0) && a + 1 < argc)
+        {
+            a = a + 1;
+            table_count = atoi(argv[a]);
+            if (table_count < 1 || table_count > MXT)
+            {
+                fprintf(stderr, "Table count must be between 1 and %d\n", MXT);
+                return 1;
+            }
+        }
+        else if ((strcmp(argv[a], "--players") == 0 || strcmp(argv[a], "-p") == 0) && a + 1 < argc)
+        {
+            a = a + 1;
+            mxp = atoi(argv[a]);
+        }
+        else if (strcmp(argv[a], "--min") == 0 && a + 1 < argc)
+        {
+            a = a + 1;
+            mnp = atoi(argv[a]);
+            min_set = 1;
+        }
+        else if ((strcmp(argv[a], "--goal") == 0 || strcmp(argv[a], "-g") == 0) && a + 1 < argc)
+        {
+            a = a + 1;
+            wc = atoi(argv[a]);
+            if (wc < 1 || wc > GM)
+            {
+                fprintf(stderr, "Goal must be between row 1 and row %d\n", GM);
+                return 1;
+            }
+        }
+        else
+        {
+            printf("Usage: %s [--epoll | --mailbox] [--socket] [--tables N] [--players N] [--min N] [--goal N] [--continuous]\n", argv[0]);
+            printf("  --epoll       serve all players of a table from one event loop, no forked handlers\n");
+            printf("  --tables N    host N independent games at once (default 1, max %d)\n", MXT);
+            printf("  --players N   seats per table (default %d, max %d)\n", MXP, MXS);
+            printf("  --min N       players a table waits for before the game starts (default %d)\n", MNP);
+            printf("  --goal N      row that wins the race (default %d, max %d)\n", WC, GM);
+            printf("  --continuous  start the next game on a table as soon as one ends, until Ctrl+C\n");
+            printf("  --mailbox     players talk to their handler through shared memory instead of FIFOs\n");
+            printf("  --socket      players connect to one Unix socket (%s) instead of FIFOs\n", sock_path);
+            return 1;
+        }
+    }
+
+    if (epoll_mode == 1 && mailbox_mode == 1)
+    {
+        fprintf(stderr, "--mailbox needs one handler per player, it cannot be combined with --epoll\n");
+        return 1;
+    }
+
+    if (mailbox_mode == 1 && socket_mode == 1)
+    {
+        fprintf(stderr, "--mailbox and --socket are both transports, pick one\n");
+        return 1;
+    }
+
+    if (mxp < 2 || mxp > MXS)
+    {
+        fprintf(stderr, "Players per table must be between 2 and %d\n", MXS);
+        return 1;
+    }
+
+    if (min_set == 0 && mnp > mxp)
+    {
+        mnp = mxp;
+    }
+
+    if (mnp < 2 || mnp > mxp)
+    {
+        fprintf(stderr, "Minimum players must be between 2 and the %d seats of a table\n", mxp);
+        return 1;
+    }
+
     printf("\n");
     printf(" ============================================================\n");
     printf(" |               Welcome to DICE RACE GAME!                 |\n");
     printf(" ============================================================\n");
     printf(" |                                                          |\n");
     printf(" | HOW TO PLAY (Instruction):                               |\n");
-    printf(" | 1. Wait for minimum %d players to join                    |\n", MNP);
-    printf(" |  (Maximum of  %d players are allowed)                     |\n", MXP);
+    printf(" | 1. Wait for minimum %d players to join                    |\n", mnp);
+    printf(" |  (Maximum of  %d players are allowed)                     |\n", mxp);
     printf(" | 2. Type: ./client YourName (in your own terminal)        |\n");
     printf(" | 3. HIT ENTER when it's your turn, else WAIT              |\n");
     printf(" | 4. First player that reach the Row %d WINS!              |\n", wc);
@@ -189,38 +630,95 @@ int main()
     printf("\n");
 
     printf("Server Process ID: %d\n", getpid());
-    printf("Waiting for %d to %d players...\n\n", MNP, MXP);
+    printf("Hosting %d table(s), each waiting for %d to %d players...\n\n", table_count, mnp, mxp);
     
-    int i;
-    for (i = 0; i < MXP; i = i + 1) 
+    server_pid = getpid();
+
+    log_fd = open(log, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log_fd == -1)
     {
-        child_pids[i] = -1;
+        perror("Log file open failed");
+        exit(EXIT_FAILURE);
     }
-    
+
+    if (pipe(stop_pipe) == -1)
+    {
+        perror("Stop pipe creation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(join_fifo);
+    if (mkfifo(join_fifo, 0666) == -1)
+    {
+        perror("Join FIFO creation failed");
+        exit(EXIT_FAILURE);
+    }
+    join_fd = open(join_fifo, O_RDWR | O_NONBLOCK);
+    if (join_fd == -1)
+    {
+        perror("Join FIFO open failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (socket_mode == 1)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+
+        unlink(sock_path);
+        listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+        if (listen_fd == -1 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1
+            || listen(listen_fd, SOMAXCONN) == -1)
+        {
+            perror("Socket listener setup failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
     signal(SIGCHLD, sigchld_handler);
     signal(SIGINT, sigint_handler);
+    signal(SIGUSR1, sigusr1_handler);
     
     ssm();
-    intg();
-    
-    // Set minimum players based on configuration
-    gptr->mnpr = MNP;
-    
-    // Setup process-shared mutexes
-    pthread_mutexattr_t mutex_attr;
-    pthread_mutexattr_init(&mutex_attr);
-    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&gptr->shm_lock, &mutex_attr);
-    pthread_mutex_init(&gptr->table_sync, &mutex_attr);
-    pthread_mutexattr_destroy(&mutex_attr);
+
+    int t;
+    for (t = 0; t < table_count; t = t + 1)
+    {
+        intg(t);
+    }
+
+    // clients refuse the segment until this is set, so none sees a half initialised table or the wrong mode
+    __atomic_store_n(&shm->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+    if (epoll_mode == 1)
+    {
+        srand(time(NULL) ^ getpid());
+        printf("[Main] Epoll mode: one event loop per table serves its players\n");
+    }
+
+    if (socket_mode == 1)
+    {
+        printf("[Main] Socket mode: players connect to %s\n", sock_path);
+    }
+
+    if (mailbox_mode == 1)
+    {
+        printf("[Main] Mailbox mode: rolls travel through shared memory, no player FIFOs\n");
+    }
+
+    if (continuous_mode == 1)
+    {
+        printf("[Main] Continuous mode: tables play back-to-back games until Ctrl+C\n");
+    }
 
     // Initialize log queue
     log_queue.head = NULL;
     log_queue.tail = NULL;
     pthread_mutex_init(&log_queue.mutex, NULL);
-    pthread_cond_init(&log_queue.cond, NULL);
 
-    ls();
+    gptr = tp(shm, 0);
     
     printf("[Main] Creating logger thread...\n");
     int create_result;
@@ -240,252 +738,279 @@ int main()
         csm();
         exit(EXIT_FAILURE);
     }
+
+    // one scoreboard for every table, mapped before any of them seats a player
+    ls();
+
+    printf("[Main] Creating %d table thread(s)...\n", table_count);
+    for (t = 0; t < table_count; t = t + 1)
+    {
+        create_result = pthread_create(&tables[t].thread, NULL, tt, &tables[t]);
+        if (create_result != 0)
+        {
+            fprintf(stderr, "Table thread creation failed: %s\n", strerror(create_result));
+            csm();
+            exit(EXIT_FAILURE);
+        }
+    }
     
     printf("\n[Main] Threads created successfully\n");
-    printf("[Main] Total threads running: 2\n");
+    printf("[Main] Total threads running: %d\n", 2 + table_count);
     printf("  - Logger thread\n");
-    printf("  - Scheduler thread\n\n");
+    printf("  - Scheduler thread\n");
+    printf("  - %d table thread(s)\n\n", table_count);
     
     log_message("Server started - waiting for players to join...");
-    
-    while (server_running == 1 && gptr->CP < gptr->mnpr) 
+
+    // main only dispatches joins, every table runs its own game in rt()
+    while (server_running == 1 && __atomic_load_n(&tables_done, __ATOMIC_ACQUIRE) < table_count)
     {
-        for (i = 0; i < MXP; i = i + 1) 
-        {
-            if (gptr->player_active[i] == 0) 
-            {
-                char fifo_path[256];
-                snprintf(fifo_path, sizeof(fifo_path), "%s%d_to_server", fifo_p, i);
-                
-                int file_exists;
-                file_exists = access(fifo_path, F_OK);
-                
-                if (file_exists == 0) 
-                {
-                    pthread_mutex_lock(&gptr->shm_lock);
-                    gptr->player_active[i] = 1;
-                    gptr->CP = gptr->CP + 1;
-                    pthread_mutex_unlock(&gptr->shm_lock);
-                    
-                    printf("Player %d connected (%d/%d minimum)\n", 
-                           i + 1, gptr->CP, gptr->mnpr);
-                    
-                    char log_msg[256];
-                    snprintf(log_msg, sizeof(log_msg), "Player %d connected", i + 1);
-                    log_message(log_msg);
-                    
-                    pid_t child_pid;
-                    child_pid = fork();
-                    
-                    if (child_pid == 0) 
-                    {
-                        hd(i);
-                        exit(0);
-                    } 
-                    else if (child_pid < 0) 
-                    {
-                        fprintf(stderr, "Fork failed for player %d: %s\n", i, strerror(errno));
-                        pthread_mutex_lock(&gptr->shm_lock);
-                        gptr->player_active[i] = 0;
-                        gptr->CP = gptr->CP - 1;
-                        pthread_mutex_unlock(&gptr->shm_lock);
-                    }
-                    else
-                    {
-                        child_pids[i] = child_pid;
-                        child_count_total = child_count_total + 1;
-                    }
-                }
-            }
-        }
-        sleep(1);
+        wj();
     }
-    
-    // Check if we have enough players
-    if (server_running ==0 || gptr->CP < gptr->mnpr) 
+
+    // nobody can be seated any more, let the queued clients go
+    int q;
+    for (q = 0; q < lobby_count; q = q + 1)
     {
-        printf("\n[Main] Server shutting down before game start\n");
-        csm();
-        exit(EXIT_SUCCESS);
+        sr(lobby[q].pid, -1, -1);
+    }
+    lobby_count = 0;
+
+    for (q = 0; q < hello_count; q = q + 1)
+    {
+        close(hello[q].fd);
+    }
+    hello_count = 0;
+
+    for (t = 0; t < table_count; t = t + 1)
+    {
+        pthread_join(tables[t].thread, NULL);
     }
     
-    printf("\n===========================================\n");
-    printf("  Minimum players connected!\n");
-    printf("  Starting game...\n");
-    printf("===========================================\n");
-    
-    pthread_mutex_lock(&gptr->shm_lock);
-    gptr->game_active = 1;
-    gptr->CT = 0;
+    printf("\n[Main] Cleaning up and shutting down...\n");
+    
+    server_running = 0;
+    shm->stopping = 1; // spectators and dice-stats --interval keep the segment mapped after we unlink it
+    __atomic_store_n(&log_stop, 1, __ATOMIC_RELEASE);
+    fb(&shm->log_ring.ftx, 1);
+    
+    pthread_join(logger_thread, NULL);
+    pthread_join(scheduler_thread, NULL);
+    
+    printf("[Main] Threads joined\n");
+
+    ld();
+    
+    csm();
+    
+    printf("\n===========================================\n");
+    printf("         Server Shutdown Complete           \n");
+    printf("==============================================\n");
+    
+    return 0;
+}
+
+void *tt(void *arg)
+{
+    tptr = arg;
+    gptr = tptr->g;
+
+    rt();
+
+    // continuous mode keeps the shared memory, threads, event loop and scores, only the table is reset
+    while (continuous_mode == 1 && server_running == 1)
+    {
+        rg();
+        printf("\n[Table %d] Reset for game %d, waiting for players...\n", gptr->table_id, gptr->games + 1);
+
+        // queued lobby clients can be seated here again
+        struct JoinMsg again;
+        memset(&again, 0, sizeof(again));
+        again.type = JM_WAKE;
+        again.table = gptr->table_id;
+        again.slot = -1;
+        again.pid = getpid();
+        write(join_fd, &again, sizeof(again));
+
+        rt();
+    }
+
+    if (tptr->epoll_fd != -1)
+    {
+        close(tptr->epoll_fd);
+        tptr->epoll_fd = -1;
+    }
+
+    // main sleeps in wj(), nudge it so it notices this table is finished
+    __atomic_store_n(&tptr->done, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&tables_done, 1, __ATOMIC_RELEASE);
+
+    struct JoinMsg wake;
+    memset(&wake, 0, sizeof(wake));
+    wake.type = JM_WAKE;
+    wake.table = gptr->table_id;
+    wake.slot = -1;
+    wake.pid = getpid();
+    write(join_fd, &wake, sizeof(wake));
+    return NULL;
+}
+
+void rt()
+{
+    int i;
+    int table;
+    table = gptr->table_id;
+
+    // aj() bumps state_ftx on every join, sigint_handler() on shutdown
+    while (server_running == 1 && gptr->CP < gptr->mnpr) 
+    {
+        unsigned int state_seen;
+        state_seen = __atomic_load_n(&gptr->state_ftx, __ATOMIC_ACQUIRE);
+
+        if (server_running == 1 && gptr->CP < gptr->mnpr)
+        {
+            fw(&gptr->state_ftx, state_seen, NULL);
+        }
+    }
     
-    int first_active;
-    first_active = -1;
-    for (i = 0; i < MXP; i = i + 1) 
+    // Check if we have enough players
+    if (server_running ==0 || gptr->CP < gptr->mnpr) 
     {
-        if (gptr->player_active[i] ==1) 
+        printf("\n[Table %d] Shutting down before game start\n", table);
+
+        // handlers are still asleep waiting for the start, nothing is held so just stop them
+        for (i = 0; i < mxp; i = i + 1)
         {
-            first_active = i;
-            break;
+            if (tptr->child_pids[i] > 0)
+            {
+                kill(tptr->child_pids[i], SIGTERM);
+            }
         }
+        return;
     }
-    gptr->CT = first_active;
+    
+    printf("\n===========================================\n");
+    printf("  Table %d: Minimum players connected!\n", table);
+    printf("  Starting game...\n");
+    printf("===========================================\n");
+    
+    lk(gptr);
+    wb(gptr);
+    gptr->game_active = 1;
+    mc(&gptr->counters.games_started, 1);
+    
+    // the ring is in join order, whoever sat down first opens the game
+    gptr->CT = gptr->head;
     gptr->round = 1;
+    ep(gptr, ET_START, -1, gptr->CP);
+    ep(gptr, ET_TURN, gptr->CT, gptr->round);
+    we(gptr);
     pthread_mutex_unlock(&gptr->shm_lock);
+
+    wa(gptr);
     
     char game_start_log[256];
-    snprintf(game_start_log, sizeof(game_start_log), "Game started - all players connected");
+    snprintf(game_start_log, sizeof(game_start_log), "Game started on table %d - all players connected", table);
     log_message(game_start_log);
     
-    printf("\n[Main] System status:\n");
+    printf("\n[Table %d] System status:\n", table);
     printf("   Main process PID: %d\n", getpid());
     printf("   Logger thread ID: %lu\n", (unsigned long)logger_thread);
     printf("   Scheduler thread ID: %lu\n", (unsigned long)scheduler_thread);
+    printf("   Table thread ID: %lu\n", (unsigned long)pthread_self());
     
     int child_count;
-    child_count = 0;
-    for (i = 0; i < MXP; i = i + 1) 
+    child_count = gptr->CP;
+    
+    if (epoll_mode == 1)
     {
-        if (gptr->player_active[i] == 1) 
-        {
-            child_count = child_count + 1;
-        }
+        printf("   Players on the event loop: %d\n", child_count);
+    }
+    else
+    {
+        printf("   Child processes: %d\n", child_count);
     }
-    
-    printf("   Child processes: %d\n", child_count);
-    printf("   Total: 1 parent + 2 threads + %d children\n", child_count);
     
     printf("\n==========\n");
-    printf("[Main] Game in progress...\n");
+    printf("[Table %d] Game in progress...\n", table);
     
+    if (epoll_mode == 1)
+    {
+        el();
+    }
+
+    // handlers end the game themselves, ar() and dp() bump state_ftx
     while (server_running == 1 && gptr->game_active ==1) 
     {
-        int j;
-        for (j =0; j < MXP; j = j + 1) 
+        unsigned int state_seen;
+        state_seen = __atomic_load_n(&gptr->state_ftx, __ATOMIC_ACQUIRE);
+
+        if (server_running == 1 && gptr->game_active == 1)
         {
-            if (gptr->player_active[j] ==0) 
-            {
-                char fifo_path[256];
-                snprintf(fifo_path, sizeof(fifo_path), "%s%d_to_server", fifo_p, j);
-                
-                int file_exists;
-                file_exists = access(fifo_path, F_OK);
-                
-                if (file_exists == 0) 
-                {
-                    pthread_mutex_lock(&gptr->shm_lock);
-                    gptr->player_active[j] = 1;
-                    gptr->CP = gptr->CP + 1;
-                    pthread_mutex_unlock(&gptr->shm_lock);
-                    
-                    printf("Player %d connected (%d/%d maximum)\n", 
-                           j + 1, gptr->CP, MXP);
-                    
-                    char log_msg[256];
-                    snprintf(log_msg, sizeof(log_msg), "Player %d connected", j + 1);
-                    log_message(log_msg);
-                    
-                    pid_t child_pid;
-                    child_pid = fork();
-                    
-                    if (child_pid ==0) 
-                    {
-                        hd(j);
-                        exit(0);
-                    } 
-                    else if (child_pid<0) 
-                    {
-                        fprintf(stderr, "Fork failed for player %d: %s\n", j, strerror(errno));
-                        pthread_mutex_lock(&gptr->shm_lock);
-                        gptr->player_active[j] = 0;
-                        gptr->CP = gptr->CP - 1;
-                        pthread_mutex_unlock(&gptr->shm_lock);
-                    }
-                    else
-                    {
-                        child_pids[j] = child_pid;
-                        child_count_total = child_count_total + 1;
-                    }
-                }
-            }
+            fw(&gptr->state_ftx, state_seen, NULL);
         }
-        sleep(1);
+    }
+
+    if (server_running == 0)
+    {
+        ge();
     }
     
     printf("\n=========================================\n");
-    printf("                 Game Ended!               \n");
+    printf("             Table %d Game Ended!          \n", table);
     printf("============================================\n");
     
-    if (gptr->FW >= 0 && gptr->FW<MXP) 
+    if (gptr->FW >= 0 && gptr->FW<mxp) 
     {
-        printf("Winner: %s (Slot %d)\n", gptr->PN[gptr->FW], gptr->FW + 1);
-        printf("Total wins for %s: %d\n", gptr->PN[gptr->FW], gptr->TWN[gptr->FW]);
+        mc(&gptr->counters.games_finished, 1);
+        printf("Winner: %s (Slot %d)\n", pn(gptr)[gptr->FW], gptr->FW + 1);
+        printf("Total wins for %s: %d\n", pn(gptr)[gptr->FW], tw(gptr)[gptr->FW]);
     }
     
     printf("\nFinal Standings:\n");
-    for (i = 0; i < MXP; i = i + 1) 
+    for (i = 0; i < mxp; i = i + 1) 
     {
-        if (gptr->player_active[i] ==1) 
+        if (pa(gptr)[i] ==1) 
         {
             printf("  %s: R%d (Total wins: %d)\n", 
-                   gptr->PN[i], 
-                   gptr->PP[i], 
-                   gptr->TWN[i]);
+                   pn(gptr)[i], 
+                   pp(gptr)[i], 
+                   tw(gptr)[i]);
         }
     }
     
     ss();
     
-    printf("\nWaiting for all child processes to finish...\n");
-    
-    int wait_status;
+    printf("\n[Table %d] Waiting for its child processes to finish...\n", table);
+
+    // only this table's handlers, other tables may still be playing
     int children_left;
-    children_left = child_count_total;
-    
-    while (children_left > 0)
+    children_left = tptr->child_count_total;
+
+    for (i = 0; i < mxp; i = i + 1)
     {
-        pid_t finished_pid;
-        finished_pid = waitpid(-1, &wait_status, 0);
-        
-        if (finished_pid > 0)
+        if (tptr->child_pids[i] > 0)
         {
-            children_left = children_left - 1;
-            printf("[Main] Child process %d finished (%d remaining)\n", finished_pid, children_left);
-        }
-        else if (finished_pid == -1)
-        {
-            if (errno == ECHILD)
+            int wait_status;
+            pid_t finished_pid;
+            finished_pid = waitpid(tptr->child_pids[i], &wait_status, 0);
+
+            // sigchld_handler() may have reaped it already
+            if (finished_pid > 0 || errno == ECHILD)
             {
-                break;
+                children_left = children_left - 1;
+                printf("[Table %d] Child process %d finished (%d remaining)\n", table, tptr->child_pids[i], children_left);
             }
+            tptr->child_pids[i] = -1;
         }
     }
     
-    printf("[Main] All child processes have finished\n");
-    
-    printf("\n[Main] Cleaning up and shutting down...\n");
-    
-    server_running = 0;
-    pthread_mutex_lock(&log_queue.mutex);
-    pthread_cond_signal(&log_queue.cond);
-    pthread_mutex_unlock(&log_queue.mutex);
-    
-    pthread_join(logger_thread, NULL);
-    pthread_join(scheduler_thread, NULL);
-    
-    printf("[Main] Threads joined\n");
-    
-    csm();
-    
-    printf("\n===========================================\n");
-    printf("         Server Shutdown Complete           \n");
-    printf("==============================================\n");
-    
-    return 0;
+    printf("[Table %d] All child processes have finished\n", table);
 }
 
 void ssm() 
 {
-    shared_mem_fd = shm_open("/dice_game_shm", O_CREAT | O_RDWR, 0666);
+    shared_mem_fd = shm_open(shm_name, O_CREAT | O_RDWR, 0666);
     
     if (shared_mem_fd == -1) 
     {
@@ -493,167 +1018,1246 @@ void ssm()
         exit(EXIT_FAILURE);
     }
     
+    // every table carries its per slot arrays, so the segment grows with --players as well as --tables
     int truncate_result;
-    truncate_result = ftruncate(shared_mem_fd, sizeof(struct GameInfo));
+    truncate_result = ftruncate(shared_mem_fd, shm_size(table_count, tz(mxp, NULL)));
     
     if (truncate_result == -1) 
     {
         perror("Shared memory truncation failed");
         exit(EXIT_FAILURE);
     }
-    
-    gptr = mmap(NULL, sizeof(struct GameInfo), 
-                    PROT_READ | PROT_WRITE, MAP_SHARED, shared_mem_fd,0);
-    
-    if (gptr == MAP_FAILED) 
+    
+    shm = mmap(NULL, shm_size(table_count, tz(mxp, NULL)), 
+                    PROT_READ | PROT_WRITE, MAP_SHARED, shared_mem_fd,0);
+    
+    if (shm == MAP_FAILED) 
+    {
+        perror("Memory mapping failed");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(shm, 0, sizeof(struct ShmHeader));
+    shm->version = SHM_VERSION;
+    shm->header_size = sizeof(struct ShmHeader);
+    shm->info_size = sizeof(struct GameInfo);
+    shm->table_size = tz(mxp, NULL);
+    shm->slots = mxp;
+    shm->min_players = mnp;
+    shm->goal = wc;
+    shm->tables = table_count;
+    shm->continuous = continuous_mode;
+    shm->mailbox = mailbox_mode;
+    shm->socket = socket_mode; // every mode flag is in place before main stores the magic
+    shm->metrics.started = mn();
+
+    // a record is free for position p while its seq is p
+    int r;
+    for (r = 0; r < LR; r = r + 1)
+    {
+        shm->log_ring.rec[r].seq = r;
+    }
+}
+
+void csm() 
+{
+    int t;
+    int i;
+
+    if (shm != NULL) 
+    {
+        for (t = 0; t < table_count; t = t + 1)
+        {
+            pthread_mutex_destroy(&tp(shm, t)->shm_lock);
+            pthread_mutex_destroy(&tp(shm, t)->table_sync);
+        }
+        munmap(shm, shm_size(table_count, shm->table_size));
+    }
+
+    if (sb != NULL)
+    {
+        munmap(sb, sb_len);
+        sb = NULL;
+    }
+    
+    shm_unlink(shm_name);
+    unlink(join_fifo);
+
+    if (listen_fd != -1)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(sock_path);
+    }
+    
+    for (t = 0; t < table_count; t = t + 1)
+    {
+        for (i = 0; i < mxp; i = i + 1) 
+        {
+            char fifo_path[256];
+            
+            fpath(fifo_path, sizeof(fifo_path), t, i, "to_server");
+            unlink(fifo_path);
+            
+            fpath(fifo_path, sizeof(fifo_path), t, i, "from_server");
+            unlink(fifo_path);
+        }
+    }
+    
+    pthread_mutex_destroy(&log_queue.mutex);
+
+    if (log_fd != -1)
+    {
+        close(log_fd);
+        log_fd = -1;
+    }
+    
+    struct LogNode *current_node;
+    current_node = log_queue.head;
+    
+    while (current_node != NULL) 
+    {
+        struct LogNode *next_node;
+        next_node = current_node->next;
+        free(current_node);
+        current_node = next_node;
+    }
+}
+
+void intg(int table) 
+{
+    struct GameInfo *g;
+    g = tp(shm, table);
+    memset(g, 0, shm->table_size);
+    tz(mxp, g);
+    
+    int i;
+    for (i = 0; i < mxp; i = i + 1) 
+    {
+        pp(g)[i] = 0;
+        pa(g)[i] =0;
+    }
+    fa(g);
+    
+    g->table_id = table;
+    g->CT = 0;
+    g->game_active =0;
+    g->CP =0;
+    g->FW = -1;
+    g->round =0;
+    g->head = -1;
+
+    // Set minimum players based on configuration
+    g->mnpr = mnp;
+
+    // Setup process-shared mutexes, one pair per table so tables never contend
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&g->shm_lock, &mutex_attr);
+    pthread_mutex_init(&g->table_sync, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    struct Table *tb;
+    tb = &tables[table];
+    tb->g = g;
+    tb->child_count_total = 0;
+    tb->epoll_fd = -1;
+    tb->done = 0;
+    tb->child_pids = malloc(mxp * sizeof(pid_t));
+    tb->ep_read = malloc(mxp * sizeof(int));
+    tb->ep_write = malloc(mxp * sizeof(int));
+    tb->ep_in = malloc(mxp * sizeof(struct FrameIn));
+    if (tb->child_pids == NULL || tb->ep_read == NULL || tb->ep_write == NULL || tb->ep_in == NULL)
+    {
+        perror("Table allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < mxp; i = i + 1)
+    {
+        tb->child_pids[i] = -1;
+        tb->ep_read[i] = -1;
+        tb->ep_write[i] = -1;
+    }
+
+    if (epoll_mode == 1)
+    {
+        tb->epoll_fd = epoll_create1(0);
+        if (tb->epoll_fd == -1)
+        {
+            perror("Epoll creation failed");
+            exit(EXIT_FAILURE);
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = mxp; // slot numbers are 0..mxp-1, mxp marks the stop pipe
+        epoll_ctl(tb->epoll_fd, EPOLL_CTL_ADD, stop_pipe[0], &ev);
+    }
+}
+
+// clear the board for the next game, total wins stay, handlers of the last game have already exited
+void rg() 
+{
+    lk(gptr);
+    wb(gptr);
+    
+    int i;
+    for (i = 0; i < mxp; i = i + 1) 
+    {
+        pp(gptr)[i] = 0;
+        pa(gptr)[i] =0;
+        sp(gptr)[i] = 0;
+        pn(gptr)[i][0] = '\0';
+    }
+    fa(gptr);
+    __atomic_add_fetch(&gptr->names, 1, __ATOMIC_RELEASE);
+    
+    gptr->CT =0;
+    gptr->game_active = 0;
+    gptr->CP = 0;
+    gptr->FW = -1;
+    gptr->round =0;
+    gptr->head = -1;
+    gptr->games = gptr->games + 1;
+    ep(gptr, ET_RESET, -1, 0);
+
+    we(gptr);
+    pthread_mutex_unlock(&gptr->shm_lock);
+
+    tptr->child_count_total = 0;
+
+    // clients staying for another round sleep on state_ftx until games changes
+    fb(&gptr->state_ftx, INT_MAX);
+}
+
+// hand the turn to the next active player, caller holds shm_lock and wakes the returned slot after unlocking
+// one step along the ring of seated slots, so a table with hundreds of empty seats costs the same
+int nt()
+{
+    int next_player;
+    next_player = sl(gptr)[gptr->CT].nx;
+
+    gptr->CT = next_player;
+
+    if (next_player == gptr->head)
+    {
+        gptr->round = gptr->round +1;
+    }
+    ep(gptr, ET_TURN, next_player, gptr->round);
+    return next_player;
+}
+
+// seat the slot last in turn order, caller holds shm_lock
+void ri(int player_id)
+{
+    struct SlotLine *s;
+    s = sl(gptr);
+
+    if (gptr->head == -1)
+    {
+        s[player_id].nx = player_id;
+        s[player_id].pv = player_id;
+        gptr->head = player_id;
+        return;
+    }
+
+    int last;
+    last = s[gptr->head].pv;
+    s[player_id].nx = gptr->head;
+    s[player_id].pv = last;
+    s[last].nx = player_id;
+    s[gptr->head].pv = player_id;
+}
+
+// take the slot out of turn order, caller holds shm_lock and has already passed the turn on if it was theirs
+void ru(int player_id)
+{
+    struct SlotLine *s;
+    s = sl(gptr);
+
+    if (s[player_id].nx == player_id)
+    {
+        gptr->head = -1;
+        return;
+    }
+
+    s[s[player_id].pv].nx = s[player_id].nx;
+    s[s[player_id].nx].pv = s[player_id].pv;
+    if (gptr->head == player_id)
+    {
+        gptr->head = s[player_id].nx;
+    }
+}
+
+// bump every turn word so sleeping handlers re-check game_active, used on game start and game end, then wake the clients
+void wa(struct GameInfo *g)
+{
+    int i;
+    for (i = 0; i < mxp; i = i + 1)
+    {
+        fb(&sl(g)[i].turn_ftx, 1);
+        if (mailbox_mode == 1)
+        {
+            fb(&mt(g)[i].ftx, 1); // a handler waiting in mr() for the ROLL
+        }
+    }
+    fb(&g->state_ftx, INT_MAX);
+}
+
+// Ctrl+C only flagged the shutdown, the game is stopped here where taking shm_lock is safe
+void ge()
+{
+    lk(gptr);
+    int stopped;
+    stopped = gptr->game_active;
+    if (stopped == 1)
+    {
+        wb(gptr);
+        gptr->game_active = 0;
+        ep(gptr, ET_END, -1, 0);
+        we(gptr);
+    }
+    pthread_mutex_unlock(&gptr->shm_lock);
+
+    if (stopped == 1)
+    {
+        wa(gptr);
+    }
+}
+
+// move the player, end the game or hand the turn on, then wake whoever is affected
+int ar(int player_id, int dice_value, long long read_at)
+{
+    int next_player;
+    next_player = -1;
+
+    lk(gptr);
+    wb(gptr);
+
+    long long locked;
+    locked = mn();
+    hr(&shm->lat[PH_LOCK], locked - read_at);
+
+    pp(gptr)[player_id] = pp(gptr)[player_id] + dice_value;
+    mc(&gptr->counters.turns, 1);
+    ep(gptr, ET_ROLL, player_id, dice_value);
+
+    long long moved;
+    moved = mn();
+    hr(&shm->lat[PH_MOVE], moved - locked);
+
+    if (pp(gptr)[player_id] >= wc)
+    {
+        pp(gptr)[player_id] = wc;
+        gptr->FW = player_id;
+        gptr->game_active =0;
+
+        // the record aj() found, wins follow the name rather than the seat
+        struct ScoreRec *rec;
+        rec = sk(pn(gptr)[player_id], 0);
+        if (rec != NULL)
+        {
+            tw(gptr)[player_id] = __atomic_add_fetch(&rec->wins, 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            tw(gptr)[player_id] = tw(gptr)[player_id] + 1;
+        }
+        ep(gptr, ET_MOVE, player_id, wc);
+        ep(gptr, ET_WIN, player_id, wc);
+    }
+    else
+    {
+        ep(gptr, ET_MOVE, player_id, pp(gptr)[player_id]);
+        next_player = nt();
+    }
+
+    long long advanced;
+    advanced = mn();
+
+    int position;
+    position = pp(gptr)[player_id];
+
+    we(gptr);
+    pthread_mutex_unlock(&gptr->shm_lock);
+
+    if (next_player >= 0)
+    {
+        hr(&shm->lat[PH_TURN], advanced - moved);
+        __atomic_store_n(&gptr->turn_ts, mn(), __ATOMIC_RELAXED);
+        fb(&sl(gptr)[next_player].turn_ftx, 1);
+        fb(&gptr->state_ftx, INT_MAX);
+        hr(&shm->lat[PH_NOTIFY], mn() - advanced);
+    }
+    else
+    {
+        wa(gptr);
+    }
+    return position;
+}
+
+// the client went away, free the slot and pass the turn on if it was theirs
+void dp(int player_id)
+{
+    int next_player;
+    next_player = -1;
+
+    lk(gptr);
+    wb(gptr);
+    pa(gptr)[player_id] = 0;
+    sp(gptr)[player_id] = 0;
+    gptr->CP = gptr->CP - 1;
+    ep(gptr, ET_LEAVE, player_id, 0);
+    if (gptr->CT == player_id && sl(gptr)[player_id].nx != player_id)
+    {
+        next_player = nt();
+    }
+
+    // the last seated player left a running game, nobody is left to take the turn so it is over
+    int emptied;
+    emptied = gptr->game_active == 1 && sl(gptr)[player_id].nx == player_id;
+    if (emptied == 1)
+    {
+        // no winner to keep FW from -1, close the table by hand so cl(), rj(), ac() and mm() leave it
+        // alone until rg() has cleared it
+        __atomic_store_n(&gptr->FW, FC, __ATOMIC_RELEASE);
+        gptr->game_active = 0;
+        ep(gptr, ET_END, -1, 0);
+    }
+
+    ru(player_id);
+    fr(gptr, player_id);
+    we(gptr);
+    pthread_mutex_unlock(&gptr->shm_lock);
+
+    if (next_player >= 0)
+    {
+        __atomic_store_n(&gptr->turn_ts, mn(), __ATOMIC_RELAXED);
+        fb(&sl(gptr)[next_player].turn_ftx, 1);
+    }
+    if (emptied == 1)
+    {
+        wa(gptr);
+        return;
+    }
+    fb(&gptr->state_ftx, INT_MAX);
+}
+
+// sleep until a client writes to the join FIFO or the server is stopped
+void wj()
+{
+    struct pollfd pfd[3 + HQ];
+    pfd[0].fd = join_fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = stop_pipe[0];
+    pfd[1].events = POLLIN;
+    pfd[2].fd = listen_fd; // -1 unless --socket, poll() skips it then
+    pfd[2].events = POLLIN;
+
+    int i;
+    for (i = 0; i < hello_count; i = i + 1)
+    {
+        pfd[3 + i].fd = hello[i].fd;
+        pfd[3 + i].events = POLLIN;
+    }
+
+    // only wake up for the deadline of the oldest connection that has not spoken yet
+    int timeout;
+    timeout = -1;
+    if (hello_count > 0)
+    {
+        long long left;
+        left = (hello[0].since + (long long)HW * 1000000LL - mn()) / 1000000LL;
+        timeout = left > 0 ? (int)left + 1 : 0;
+    }
+
+    int polled;
+    polled = hello_count;
+
+    if (poll(pfd, 3 + polled, timeout) >= 0)
+    {
+        for (i = 0; i < polled; i = i + 1)
+        {
+            if (pfd[3 + i].revents != 0)
+            {
+                hj(i);
+            }
+        }
+        hx();
+
+        if (pfd[2].revents != 0)
+        {
+            ac();
+        }
+        if (pfd[0].revents != 0)
+        {
+            rj();
+        }
+    }
+}
+
+// a connection is a join, it waits in hello[] until its first packet arrives, main never blocks on it
+void ac()
+{
+    while (1)
+    {
+        int sock;
+        sock = accept(listen_fd, NULL, NULL);
+        if (sock == -1)
+        {
+            return;
+        }
+
+        if (hello_count == HQ)
+        {
+            mc(&shm->metrics.join_refused, 1);
+            printf("[Main] Too many connections waiting to join, closing a new one\n");
+            close(sock);
+            continue;
+        }
+
+        hello[hello_count].fd = sock;
+        hello[hello_count].since = mn();
+        hello_count = hello_count + 1;
+    }
+}
+
+// read the first packet of hello[i], it names the claimed slot and the kernel tells us who really sent it
+void hj(int i)
+{
+    int sock;
+    sock = hello[i].fd;
+
+    struct JoinMsg msg;
+    ssize_t got;
+    got = recv(sock, &msg, sizeof(msg), MSG_DONTWAIT);
+    if (got == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return; // not here yet, hx() drops it if it never comes
+    }
+    hello[i].fd = -1;
+
+    struct ucred cred;
+    socklen_t cred_len;
+    cred_len = sizeof(cred);
+
+    int found_table;
+    int found_slot;
+    found_table = -1;
+    found_slot = -1;
+
+    if (got == sizeof(msg) && getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0
+        && msg.type == JM_JOIN && msg.table >= 0 && msg.table < table_count && msg.slot >= 0 && msg.slot < mxp)
+    {
+        struct GameInfo *g;
+        g = tables[msg.table].g;
+
+        // the kernel's pid, not the one in the message, has to hold the slot
+        lk(g);
+        if (sp(g)[msg.slot] == cred.pid && pa(g)[msg.slot] == 0 && g->FW == -1)
+        {
+            found_table = msg.table;
+            found_slot = msg.slot;
+        }
+        pthread_mutex_unlock(&g->shm_lock);
+    }
+
+    if (found_table == -1)
+    {
+        mc(&shm->metrics.join_refused, 1);
+        printf("[Main] Closing a connection that holds no claimed slot\n");
+        close(sock);
+        return;
+    }
+
+    tptr = &tables[found_table];
+    gptr = tptr->g;
+    tptr->ep_read[found_slot] = sock;
+    tptr->ep_write[found_slot] = sock;
+    aj(found_slot);
+}
+
+// hello expire, forget the connections hj() took and close the ones that stayed silent past HW ms
+void hx()
+{
+    long long now;
+    now = mn();
+
+    int kept;
+    kept = 0;
+
+    int i;
+    for (i = 0; i < hello_count; i = i + 1)
+    {
+        if (hello[i].fd != -1 && now - hello[i].since >= (long long)HW * 1000000LL)
+        {
+            mc(&shm->metrics.join_refused, 1);
+            printf("[Main] Closing a connection that sent nothing for %d ms\n", HW);
+            close(hello[i].fd);
+            hello[i].fd = -1;
+        }
+        if (hello[i].fd != -1)
+        {
+            hello[kept] = hello[i];
+            kept = kept + 1;
+        }
+    }
+    hello_count = kept;
+}
+
+// drain the join FIFO, queue lobby requests and accept slots the clients already claimed
+void rj()
+{
+    struct JoinMsg msg;
+
+    while (read(join_fd, &msg, sizeof(msg)) == sizeof(msg))
+    {
+        if (msg.type == JM_LOBBY)
+        {
+            if (lobby_count == LQ)
+            {
+                mc(&shm->metrics.join_refused, 1);
+                printf("[Main] Lobby full, turning away PID %d\n", msg.pid);
+                sr(msg.pid, -1, -1);
+                continue;
+            }
+
+            lobby[lobby_count].pid = msg.pid;
+            strncpy(lobby[lobby_count].name, msg.name, 49);
+            lobby[lobby_count].name[49] = '\0';
+            lobby_count = lobby_count + 1;
+            printf("[Main] %s (PID %d) is waiting in the lobby (%d queued)\n", lobby[lobby_count - 1].name, msg.pid, lobby_count);
+            continue;
+        }
+
+        if (msg.type != JM_JOIN || msg.table < 0 || msg.table >= table_count || msg.slot < 0 || msg.slot >= mxp)
+        {
+            continue; // wake-up only, e.g. a table just finished
+        }
+
+        // with --socket the connection is the join, a record here has no connection to serve
+        // and its pid was never checked by the kernel
+        if (socket_mode == 1)
+        {
+            mc(&shm->metrics.join_refused, 1);
+            printf("[Main] Ignoring FIFO join for table %d slot %d from PID %d, this server takes joins on %s\n", msg.table, msg.slot + 1, msg.pid, sock_path);
+            continue;
+        }
+
+        // aj() works on the current table, main switches to the one this join is for
+        tptr = &tables[msg.table];
+        gptr = tptr->g;
+
+        int valid;
+        lk(gptr);
+        valid = pa(gptr)[msg.slot] == 0 && sp(gptr)[msg.slot] == msg.pid && gptr->FW == -1;
+        pthread_mutex_unlock(&gptr->shm_lock);
+
+        if (valid == 1)
+        {
+            aj(msg.slot);
+        }
+        else
+        {
+            mc(&shm->metrics.join_refused, 1);
+            printf("[Main] Ignoring join for table %d slot %d from PID %d\n", msg.table, msg.slot + 1, msg.pid);
+        }
+    }
+
+    mm();
+}
+
+// fill tables that are still gathering players first, open a fresh table once a full minimum is queued,
+// and only then squeeze the rest into games already running
+void mm()
+{
+    int t;
+
+    if (lobby_count == 0)
+    {
+        return;
+    }
+
+    // pass 0: tables waiting for their start, pass 1: empty tables, pass 2: running games with a free seat
+    int pass;
+    for (pass = 0; pass < 3 && lobby_count > 0; pass = pass + 1)
+    {
+        for (t = 0; t < table_count && lobby_count > 0; t = t + 1)
+        {
+            struct GameInfo *g;
+            g = tables[t].g;
+
+            if (__atomic_load_n(&tables[t].done, __ATOMIC_ACQUIRE) == 1 || g->FW != -1)
+            {
+                continue;
+            }
+
+            int claimed;
+            int active;
+            active = g->game_active;
+
+            // every seat missing from the free map is claimed or played
+            claimed = g->slots - __atomic_load_n(&g->free_n, __ATOMIC_RELAXED);
+
+            if (pass == 0 && active == 0 && claimed > 0)
+            {
+                st(t);
+            }
+            else if (pass == 1 && active == 0 && claimed == 0 && lobby_count >= mnp)
+            {
+                printf("[Main] Lobby opens table %d for %d waiting player(s)\n", t, lobby_count < mxp ? lobby_count : mxp);
+                st(t);
+            }
+            else if (pass == 2 && active == 1)
+            {
+                st(t);
+            }
+        }
+    }
+}
+
+// claim slots for the oldest lobby clients and tell each one where it sits
+int st(int table)
+{
+    struct GameInfo *g;
+    g = tables[table].g;
+
+    int seated;
+    seated = 0;
+
+    while (lobby_count > 0)
+    {
+        int slot;
+        slot = cl(g, lobby[0].pid, lobby[0].name);
+        if (slot == -1)
+        {
+            break; // table is full
+        }
+
+        sr(lobby[0].pid, table, slot);
+        seated = seated + 1;
+
+        lobby_count = lobby_count - 1;
+        memmove(&lobby[0], &lobby[1], lobby_count * sizeof(struct Lobby));
+    }
+    return seated;
+}
+
+void sr(pid_t pid, int table, int slot)
+{
+    char reply_path[64];
+    lpath(reply_path, sizeof(reply_path), pid);
+
+    struct JoinMsg reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.type = JM_LOBBY;
+    reply.table = table;
+    reply.slot = slot;
+    reply.pid = pid;
+
+    // non-blocking so a client that gave up cannot stall main
+    int reply_fd;
+    reply_fd = open(reply_path, O_WRONLY | O_NONBLOCK);
+
+    if (reply_fd == -1 || write(reply_fd, &reply, sizeof(reply)) != sizeof(reply))
+    {
+        if (table >= 0)
+        {
+            // client is gone, give the seat back
+            struct GameInfo *g;
+            g = tables[table].g;
+            lk(g);
+            if (sp(g)[slot] == pid && pa(g)[slot] == 0)
+            {
+                sp(g)[slot] = 0;
+                fr(g, slot);
+            }
+            pthread_mutex_unlock(&g->shm_lock);
+        }
+    }
+    else if (table >= 0)
+    {
+        printf("[Main] Lobby seated PID %d at table %d slot %d\n", pid, table, slot + 1);
+    }
+
+    if (reply_fd != -1)
+    {
+        close(reply_fd);
+    }
+}
+
+// mark the slot active, then fork its handler or put its FIFO on the event loop
+void aj(int player_id)
+{
+    // the client only sends once the game has started, so nobody is using the mailboxes yet
+    memset(&mt(gptr)[player_id], 0, sizeof(struct Mailbox));
+    memset(&mf(gptr)[player_id], 0, sizeof(struct Mailbox));
+
+    // a name new to the board gets its record here, before the game can hand out a win
+    struct ScoreRec *rec;
+    rec = sk(pn(gptr)[player_id], 1);
+
+    lk(gptr);
+    wb(gptr);
+    pa(gptr)[player_id] = 1;
+    gptr->CP = gptr->CP + 1;
+    if (rec != NULL)
+    {
+        tw(gptr)[player_id] = __atomic_load_n(&rec->wins, __ATOMIC_RELAXED);
+    }
+    ri(player_id);
+    ep(gptr, ET_JOIN, player_id, 0);
+    we(gptr);
+    mc(&gptr->counters.joins, 1);
+    pthread_mutex_unlock(&gptr->shm_lock);
+    fb(&gptr->state_ftx, INT_MAX);
+
+    if (gptr->game_active == 0)
+    {
+        printf("[Table %d] Player %d connected (%d/%d minimum)\n", 
+               gptr->table_id, player_id + 1, gptr->CP, gptr->mnpr);
+    }
+    else
+    {
+        printf("[Table %d] Player %d connected (%d/%d maximum)\n", 
+               gptr->table_id, player_id + 1, gptr->CP, mxp);
+    }
+
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Player %d connected to table %d", player_id + 1, gptr->table_id);
+    log_message(log_msg);
+
+    if (epoll_mode == 1)
+    {
+        // with --socket ac() already put the connection in ep_read and ep_write
+        if (socket_mode == 0)
+        {
+            char fifo_path[256];
+            fpath(fifo_path, sizeof(fifo_path), gptr->table_id, player_id, "to_server");
+            tptr->ep_read[player_id] = open(fifo_path, O_RDONLY | O_NONBLOCK);
+        }
+        tptr->ep_in[player_id].len = 0;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = player_id;
+
+        if (tptr->ep_read[player_id] == -1 || epoll_ctl(tptr->epoll_fd, EPOLL_CTL_ADD, tptr->ep_read[player_id], &ev) == -1)
+        {
+            fprintf(stderr, "Event loop setup failed for player %d: %s\n", player_id, strerror(errno));
+            if (tptr->ep_read[player_id] != -1)
+            {
+                close(tptr->ep_read[player_id]);
+                tptr->ep_read[player_id] = -1;
+                tptr->ep_write[player_id] = -1;
+            }
+            dp(player_id);
+        }
+        return;
+    }
+
+    pid_t child_pid;
+    child_pid = fork();
+
+    if (child_pid == 0) 
+    {
+        // Ctrl+C reaches the whole process group, the server stops the game and hd() follows it
+        signal(SIGINT, SIG_IGN);
+        hd(player_id);
+        exit(0);
+    } 
+    else if (child_pid < 0) 
+    {
+        fprintf(stderr, "Fork failed for player %d: %s\n", player_id, strerror(errno));
+        lk(gptr);
+        wb(gptr);
+        pa(gptr)[player_id] = 0;
+        sp(gptr)[player_id] = 0;
+        gptr->CP = gptr->CP - 1;
+        ru(player_id);
+        fr(gptr, player_id); // nobody will be served here, the seat is free again
+        ep(gptr, ET_LEAVE, player_id, 0);
+        we(gptr);
+        pthread_mutex_unlock(&gptr->shm_lock);
+        fb(&gptr->state_ftx, INT_MAX);
+    }
+    else
+    {
+        tptr->child_pids[player_id] = child_pid;
+        tptr->child_count_total = tptr->child_count_total + 1;
+    }
+
+    // the handler owns the connection now, our copy would hide its hang-up
+    if (socket_mode == 1)
+    {
+        close(tptr->ep_read[player_id]);
+        tptr->ep_read[player_id] = -1;
+        tptr->ep_write[player_id] = -1;
+    }
+}
+
+// a ROLL on the player's turn moves them and fills in the ROLLED reply, anything else is ignored (returns 0)
+// nothing slow in here, the caller sends the reply first and only then calls rn()
+int ro(int player_id, const struct Frame *request, struct Frame *reply)
+{
+    if (request->type != MT_ROLL || gptr->CT != player_id || gptr->game_active == 0)
+    {
+        return 0;
+    }
+
+    long long read_at;
+    read_at = mn();
+    hr(&shm->lat[PH_SEND], read_at - request->ts);
+
+    int dice_value;
+    dice_value = (rand() % 6) + 1;
+
+    ar(player_id, dice_value, read_at);
+
+    reply->type = MT_ROLLED;
+    reply->player = player_id;
+    reply->seq = request->seq;
+    reply->payload = dice_value; // ts is stamped by the caller right before the send, PH_REPLY is transport time only
+    return 1;
+}
+
+void rn(int player_id, const struct Frame *reply, const char *tag)
+{
+    if (gptr->FW == player_id)
+    {
+        printf("\n%s %s reached the goal!\n", tag, pn(gptr)[player_id]);
+        printf("%s Player %d wins! Total wins: %d\n", 
+               tag, player_id + 1, tw(gptr)[player_id]);
+    }
+
+    char roll_log[256];
+    snprintf(roll_log, sizeof(roll_log), 
+             "Player %s rolled %d! Position: R%d", 
+             pn(gptr)[player_id], 
+             reply->payload, 
+             pp(gptr)[player_id]);
+    log_message(roll_log);
+    printf("%s %s\n", tag, roll_log);
+}
+
+// epoll mode: one loop reads every player FIFO and applies rolls directly, no handler processes
+void el()
+{
+    struct epoll_event events[EV];
+
+    while (server_running == 1 && gptr->game_active == 1)
+    {
+        int ready;
+        ready = epoll_wait(tptr->epoll_fd, events, EV, -1);
+
+        int e;
+        for (e = 0; e < ready; e = e + 1)
+        {
+            int player_id;
+            player_id = events[e].data.u32;
+
+            if (player_id == mxp)
+            {
+                continue; // stop pipe, the loop condition handles it
+            }
+
+            ssize_t bytes_read;
+            bytes_read = fi(tptr->ep_read[player_id], &tptr->ep_in[player_id]);
+
+            if (bytes_read == 0)
+            {
+                epoll_ctl(tptr->epoll_fd, EPOLL_CTL_DEL, tptr->ep_read[player_id], NULL);
+                close(tptr->ep_read[player_id]);
+                if (tptr->ep_write[player_id] == tptr->ep_read[player_id])
+                {
+                    tptr->ep_write[player_id] = -1; // --socket, one descriptor both ways
+                }
+                tptr->ep_read[player_id] = -1;
+                dp(player_id);
+
+                printf("[Event-Loop] Player %d disconnected\n", player_id + 1);
+                continue;
+            }
+
+            // one read can carry several frames, a ROLL out of turn is dropped like hd() would
+            struct Frame request;
+            while (fx(&tptr->ep_in[player_id], &request) == 1)
+            {
+                struct Frame reply;
+                if (ro(player_id, &request, &reply) == 0)
+                {
+                    continue;
+                }
+
+                if (tptr->ep_write[player_id] == -1)
+                {
+                    char fifo_path[256];
+                    fpath(fifo_path, sizeof(fifo_path), gptr->table_id, player_id, "from_server");
+                    tptr->ep_write[player_id] = open(fifo_path, O_WRONLY);
+                }
+                reply.ts = mn();
+                fo(tptr->ep_write[player_id], &reply, 1);
+                rn(player_id, &reply, "[Event-Loop]");
+            }
+        }
+
+    }
+
+    int i;
+    // epoll_fd stays open for the next game, closing a FIFO also takes it off the interest list
+    for (i = 0; i < mxp; i = i + 1)
     {
-        perror("Memory mapping failed");
-        exit(EXIT_FAILURE);
+        if (tptr->ep_write[i] != -1 && tptr->ep_write[i] != tptr->ep_read[i])
+        {
+            close(tptr->ep_write[i]);
+        }
+        tptr->ep_write[i] = -1;
+        if (tptr->ep_read[i] != -1)
+        {
+            close(tptr->ep_read[i]);
+            tptr->ep_read[i] = -1;
+        }
     }
 }
 
-void csm() 
+void lf(char *buf, size_t n, const char *message, time_t at)
+{
+    char time_string[32];
+    ctime_r(&at, time_string);
+    time_string[strlen(time_string) -1] = '\0';
+    
+    snprintf(buf, n, "[%s] %s\n", time_string, message);
+}
+
+// queue the line for ltf(), callers never wait on the disk or on shm_lock
+void log_message(const char *message) 
 {
-    if (gptr != NULL) 
+    // a forked handler only has a copy of log_queue that nobody drains
+    if (getpid() != server_pid)
     {
-        pthread_mutex_destroy(&gptr->shm_lock);
-        pthread_mutex_destroy(&gptr->table_sync);
-        munmap(gptr, sizeof(struct GameInfo));
+        lp(message);
+        return;
     }
-    
-    shm_unlink("/dice_game_shm");
-    
-    int i;
-    for (i = 0; i < MXP; i = i + 1) 
+
+    struct LogNode *node;
+    node = malloc(sizeof(struct LogNode));
+    if (node == NULL)
     {
-        char fifo_path[256];
-        
-        snprintf(fifo_path, sizeof(fifo_path), "%s%d_to_server", fifo_p, i);
-        unlink(fifo_path);
-        
-        snprintf(fifo_path, sizeof(fifo_path), "%s%d_from_server", fifo_p, i);
-        unlink(fifo_path);
+        lp(message);
+        return;
     }
-    
-    pthread_mutex_destroy(&log_queue.mutex);
-    pthread_cond_destroy(&log_queue.cond);
-    
-    struct LogNode *current_node;
-    current_node = log_queue.head;
-    
-    while (current_node != NULL) 
+
+    lf(node->message, sizeof(node->message), message, time(NULL));
+    node->next = NULL;
+
+    pthread_mutex_lock(&log_queue.mutex);
+    if (log_queue.tail == NULL)
     {
-        struct LogNode *next_node;
-        next_node = current_node->next;
-        free(current_node);
-        current_node = next_node;
+        log_queue.head = node;
+    }
+    else
+    {
+        log_queue.tail->next = node;
     }
+    log_queue.tail = node;
+    mc(&shm->metrics.log_depth, 1);
+    pthread_mutex_unlock(&log_queue.mutex);
+
+    fb(&shm->log_ring.ftx, 1);
 }
 
-void intg() 
+// reserve a record by moving head on, fill it, then publish it through its seq, never blocks
+// async-signal-safe: the line is copied as it is and only ltf() formats the date, ctime_r() takes a lock
+void lp(const char *message)
 {
-    memset(gptr, 0, sizeof(struct GameInfo));
-    
-    int i;
-    for (i = 0; i < MXP; i = i + 1) 
+    struct LogRing *ring;
+    ring = &shm->log_ring;
+
+    unsigned int pos;
+    pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    struct LogRec *rec;
+    while (1)
     {
-        gptr->PP[i] = 0;
-        gptr->player_active[i] =0;
+        rec = &ring->rec[pos % LR];
+
+        int diff;
+        diff = (int)(__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0)
+        {
+            // on failure pos is reloaded with the current head
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // the logger has not consumed this record yet, the ring is full
+            __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
     }
-    
-    gptr->CT = 0;
-    gptr->game_active =0;
-    gptr->CP =0;
-    gptr->FW = -1;
-    gptr->round =0;
-}
 
-void rg() 
-{
-    pthread_mutex_lock(&gptr->shm_lock);
-    
-    int i;
-    for (i = 0; i < MXP; i = i + 1) 
+    size_t i;
+    for (i = 0; i + 1 < sizeof(rec->line) && message[i] != '\0'; i = i + 1)
     {
-        gptr->PP[i] = 0;
-        gptr->player_active[i] =0;
+        rec->line[i] = message[i];
     }
-    
-    gptr->CT =0;
-    gptr->game_active = 0;
-    gptr->CP = 0;
-    gptr->FW = -1;
-    gptr->round =0;
-    
-    pthread_mutex_unlock(&gptr->shm_lock);
+    rec->line[i] = '\0';
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    rec->at = now.tv_sec;
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+
+    fb(&ring->ftx, 1);
 }
 
-void log_message(const char *message) 
+// copy every published record into batch, writing it out whenever it fills up
+int lr(char *batch, size_t n, size_t *used)
 {
-    time_t current_time;
-    current_time = time(NULL);
-    
-    char *time_string;
-    time_string = ctime(&current_time);
-    time_string[strlen(time_string) -1] = '\0';
-    
-    char formatted_message[512];
-    snprintf(formatted_message, sizeof(formatted_message), "[%s] %s\n", time_string, message);
-    
-    pthread_mutex_lock(&gptr->shm_lock);
-    
-    FILE *log_file;
-    log_file = fopen(log, "a");
-    
-    if (log_file != NULL) 
+    struct LogRing *ring;
+    ring = &shm->log_ring;
+
+    int taken;
+    taken = 0;
+
+    while (1)
     {
-        fprintf(log_file, "%s", formatted_message);
-        fflush(log_file);
-        fclose(log_file);
+        unsigned int pos;
+        pos = ring->tail;
+
+        struct LogRec *rec;
+        rec = &ring->rec[pos % LR];
+
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != pos + 1)
+        {
+            break; // not published yet
+        }
+
+        char message[sizeof(rec->line) + 1];
+        memcpy(message, rec->line, sizeof(rec->line));
+        message[sizeof(rec->line)] = '\0';
+
+        char line[sizeof(rec->line) + 64];
+        lf(line, sizeof(line), message, (time_t)rec->at);
+
+        size_t len;
+        len = strlen(line);
+        if (*used + len > n)
+        {
+            write(log_fd, batch, *used);
+            *used = 0;
+        }
+        memcpy(batch + *used, line, len);
+        *used = *used + len;
+
+        // hand the record back to producers one lap later
+        __atomic_store_n(&rec->seq, pos + LR, __ATOMIC_RELEASE);
+        ring->tail = pos + 1;
+        taken = taken + 1;
     }
-    
-    pthread_mutex_unlock(&gptr->shm_lock);
+    return taken;
 }
 
 void *ltf(void *arg) {
     printf("[Logger Thread] Started with TID: %lu\n", (unsigned long)pthread_self());
-    FILE *log_file;
 
-    while (server_running == 1 || log_queue.head != NULL) 
+    char batch[8192]; // batch = lines collected for one write()
+    unsigned int dropped_seen;
+    dropped_seen = 0;
+
+    while (1) 
     {
+        unsigned int log_seen;
+        log_seen = __atomic_load_n(&shm->log_ring.ftx, __ATOMIC_ACQUIRE);
+
+        size_t used;
+        used = 0;
+
+        int taken;
+        taken = lr(batch, sizeof(batch), &used);
+
+        // take everything queued so far, producers start a fresh list meanwhile
         pthread_mutex_lock(&log_queue.mutex);
-        
-        while (log_queue.head == NULL && server_running == 1) 
+        struct LogNode *current_node;
+        current_node = log_queue.head;
+        log_queue.head = NULL;
+        log_queue.tail = NULL;
+        pthread_mutex_unlock(&log_queue.mutex);
+
+        // group commit, the whole batch goes out in as few writes as the buffer allows
+        while (current_node != NULL)
         {
-            pthread_cond_wait(&log_queue.cond, &log_queue.mutex);
+            mc(&shm->metrics.log_depth, -1);
+            size_t len;
+            len = strlen(current_node->message);
+            if (used + len > sizeof(batch))
+            {
+                write(log_fd, batch, used);
+                used = 0;
+            }
+            memcpy(batch + used, current_node->message, len);
+            used = used + len;
+            taken = taken + 1;
+
+            struct LogNode *next_node;
+            next_node = current_node->next;
+            free(current_node);
+            current_node = next_node;
         }
-        
-        if (log_queue.head == NULL && server_running == 0) 
+
+        unsigned int dropped;
+        dropped = __atomic_load_n(&shm->log_ring.dropped, __ATOMIC_RELAXED);
+        if (dropped != dropped_seen)
         {
-            pthread_mutex_unlock(&log_queue.mutex);
-            break;
+            char drop_line[128];
+            char drop_message[96];
+            snprintf(drop_message, sizeof(drop_message), "[Logger] Log ring full, %u record(s) dropped", dropped - dropped_seen);
+            lf(drop_line, sizeof(drop_line), drop_message, time(NULL));
+            if (used + strlen(drop_line) > sizeof(batch))
+            {
+                write(log_fd, batch, used);
+                used = 0;
+            }
+            memcpy(batch + used, drop_line, strlen(drop_line));
+            used = used + strlen(drop_line);
+            dropped_seen = dropped;
         }
 
-        struct LogNode *current_node;
-        current_node = log_queue.head;
-        log_queue.head = current_node->next;
-        
-        if (log_queue.head == NULL) 
+        if (used > 0)
         {
-            log_queue.tail = NULL;
+            write(log_fd, batch, used);
         }
-        
-        pthread_mutex_unlock(&log_queue.mutex);
 
-        log_file = fopen(log, "a");
-        if (log_file != NULL) 
+        if (dump_req == 1)
         {
-            fprintf(log_file, "%s\n", current_node->message);
-            fclose(log_file);
+            dump_req = 0;
+            ld();
+        }
+
+        if (taken == 0)
+        {
+            if (__atomic_load_n(&log_stop, __ATOMIC_ACQUIRE) == 1)
+            {
+                break;
+            }
+            // every producer bumps ftx after publishing, so nothing slips in between
+            fw(&shm->log_ring.ftx, log_seen, NULL);
         }
-        free(current_node);
     }
-    
+
+    if (dropped_seen > 0)
+    {
+        printf("[Logger Thread] %u log record(s) were dropped because the ring was full\n", dropped_seen);
+    }
     printf("[Logger Thread] Shutting down\n");
     return NULL;
 }
@@ -662,28 +2266,50 @@ void *stf(void *arg)
 {
     printf("[Scheduler Thread] Started with TID: %lu\n", (unsigned long)pthread_self());
     
-    while (server_running == 1 && gptr->game_active ==1) 
+    unsigned int seen[MXT]; // seen = gen each table had when we last looked at it
+    int live[MXT]; // live = table was playing with no winner at that gen
+    int t;
+    for (t = 0; t < table_count; t = t + 1)
     {
-        pthread_mutex_lock(&gptr->shm_lock);
-        
-        int game_should_end;
-        game_should_end = 0;
-        
-        int i;
-        for (i = 0; i < MXP; i = i + 1 ) 
+        seen[t] = 1; // odd, never a settled gen, so every table is read once
+        live[t] = 1;
+    }
+
+    int any_active;
+    any_active = 1;
+
+    while (server_running == 1 && any_active == 1) 
+    {
+        any_active = 0;
+
+        for (t = 0; t < table_count; t = t + 1)
         {
-            if (gptr->PP[i] >= wc) 
+            struct GameInfo *g;
+            g = tp(shm, t);
+
+            unsigned int now;
+            now = __atomic_load_n(&g->gen, __ATOMIC_ACQUIRE);
+
+            // same gen, same board, the answer from last time still holds
+            if (now != seen[t] && (now & 1) == 0)
             {
-                game_should_end =1;
-                break;
+                // ar() sets FW the moment a player reaches wc, no need to walk every seat or take shm_lock
+                int playing;
+                playing = g->game_active == 1 && g->FW == -1;
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                if (__atomic_load_n(&g->gen, __ATOMIC_RELAXED) == now)
+                {
+                    seen[t] = now;
+                    live[t] = playing;
+                }
+            }
+
+            // a table mid change counts as playing until it settles
+            if (live[t] == 1 || seen[t] != now)
+            {
+                any_active = 1;
             }
-        }
-        
-        pthread_mutex_unlock(&gptr->shm_lock);
-        
-        if (game_should_end == 1) 
-        {
-            break;
         }
         
         usleep(100000);
@@ -697,131 +2323,183 @@ void hd(int player_id)
 {
     char fifo_read_path[256];
     char fifo_write_path[256];
-    snprintf(fifo_read_path, sizeof(fifo_read_path), "%s%d_to_server", fifo_p, player_id);
-    snprintf(fifo_write_path, sizeof(fifo_write_path), "%s%d_from_server", fifo_p, player_id);
+    fpath(fifo_read_path, sizeof(fifo_read_path), gptr->table_id, player_id, "to_server");
+    fpath(fifo_write_path, sizeof(fifo_write_path), gptr->table_id, player_id, "from_server");
     
     usleep(2000);
     
-    printf("[Player-Handler] Started for player: %s\n", gptr->PN[player_id]);
+    printf("[Player-Handler] Started for player: %s\n", pn(gptr)[player_id]);
     printf("[Player-Handler] Slot: %d | PID: %d | Parent PID: %d\n", 
            player_id + 1, getpid(), getppid());
     
     char process_log[256];
     snprintf(process_log, sizeof(process_log), 
              "[Player-Handler] Process %d handling %s (Slot %d)", 
-             getpid(), gptr->PN[player_id], player_id + 1);
+             getpid(), pn(gptr)[player_id], player_id + 1);
     log_message(process_log);
     
     srand(time(NULL) ^ getpid());
     
     int fd_read;
     int fd_write;
-    fd_read = open(fifo_read_path, O_RDONLY | O_NONBLOCK);
-    fd_write = open(fifo_write_path, O_WRONLY);
+    fd_read = -1;
+    fd_write = -1; // opened on the first ROLL, by then the client holds the read end so open() cannot block
+    if (socket_mode == 1)
+    {
+        // the connection ac() accepted, inherited through fork()
+        fd_read = tptr->ep_read[player_id];
+        fd_write = fd_read;
+    }
+    else if (mailbox_mode == 0)
+    {
+        fd_read = open(fifo_read_path, O_RDONLY | O_NONBLOCK);
+    }
+
+    int client_fd; // client_fd = pidfd of the client, mailbox mode only (-1 = fall back to kill())
+    client_fd = -1;
+    if (mailbox_mode == 1)
+    {
+        client_fd = syscall(SYS_pidfd_open, sp(gptr)[player_id], 0);
+    }
+
+    struct FrameIn in; // in = frames read but not handled yet
+    in.len = 0;
+
+    struct pollfd pfd[2];
+    pfd[0].fd = fd_read;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = stop_pipe[0];
+    pfd[1].events = POLLIN;
+
+    // main bumps every turn word when the game starts
+    while (gptr->game_active == 0 && server_running == 1)
+    {
+        unsigned int start_seen;
+        start_seen = __atomic_load_n(&sl(gptr)[player_id].turn_ftx, __ATOMIC_ACQUIRE);
 
-    char buffer[256];
+        if (gptr->game_active == 0)
+        {
+            fw(&sl(gptr)[player_id].turn_ftx, start_seen, NULL);
+        }
+    }
 
     while (gptr->game_active == 1) 
     {
+        // sleep on our own turn word, only the handler whose turn it is gets woken
+        unsigned int turn_seen;
+        turn_seen = __atomic_load_n(&sl(gptr)[player_id].turn_ftx, __ATOMIC_ACQUIRE);
+
         if (gptr->CT != player_id) 
         {
-            usleep(100000);
+            fw(&sl(gptr)[player_id].turn_ftx, turn_seen, NULL);
+            continue;
+        }
+
+        if (mailbox_mode == 1)
+        {
+            // no EOF on a mailbox, a client that stays silent for a second is checked for life instead
+            struct Frame request;
+            struct timespec liveness;
+            liveness.tv_sec = 1;
+            liveness.tv_nsec = 0;
+
+            if (mr(&mt(gptr)[player_id], &request, &liveness) == 0)
+            {
+                // a pidfd turns readable as soon as the client exits, even before its parent reaps it
+                struct pollfd gone;
+                gone.fd = client_fd;
+                gone.events = POLLIN;
+
+                pid_t client_pid;
+                client_pid = sp(gptr)[player_id];
+
+                if ((client_fd != -1 && poll(&gone, 1, 0) > 0)
+                    || (client_fd == -1 && client_pid > 0 && kill(client_pid, 0) == -1 && errno == ESRCH))
+                {
+                    dp(player_id);
+                    break;
+                }
+                continue;
+            }
+
+            struct Frame reply;
+            if (ro(player_id, &request, &reply) == 1)
+            {
+                reply.ts = mn();
+                ms(&mf(gptr)[player_id], &reply);
+                rn(player_id, &reply, "[Player-Handler]");
+            }
+            continue;
+        }
+
+        int ready;
+        ready = poll(pfd, 2, -1);
+
+        if (ready == -1 || pfd[1].revents != 0)
+        {
             continue;
         }
 
-        memset(buffer, 0, sizeof(buffer));
         ssize_t bytes_read;
-        bytes_read = read(fd_read, buffer, sizeof(buffer));
+        bytes_read = fi(fd_read, &in);
         
         if (bytes_read > 0) 
         {
-            int compare_result;
-            compare_result = strncmp(buffer, "ROLL", 4);
-            
-            if (compare_result == 0) 
+            // several frames can arrive in one read, only a ROLL while it is still our turn counts
+            struct Frame request;
+            while (fx(&in, &request) == 1)
             {
-                int dice_value;
-                dice_value = (rand() % 6) + 1;
-                
-                pthread_mutex_lock(&gptr->shm_lock);
-                
-                gptr->PP[player_id] = gptr->PP[player_id] + dice_value;
-
-                if (gptr->PP[player_id] >= wc) 
-                {
-                    gptr->PP[player_id] = wc;
-                    gptr->FW = player_id;
-                    gptr->game_active =0;
-                    
-                    gptr->TWN[player_id] = gptr->TWN[player_id] + 1;
-                    
-                    printf("\n[Player-Handler] %s reached the goal!\n", gptr->PN[player_id]);
-                    printf("[Player-Handler] Player %d wins! Total wins: %d\n", 
-                           player_id + 1, gptr->TWN[player_id]);
-                } 
-                else 
+                struct Frame reply;
+                if (ro(player_id, &request, &reply) == 0)
                 {
-                    int next_player;
-                    next_player = (gptr->CT +1) % MXP;
-                    
-                    int attempts;
-                    attempts = 0;
-                    while (gptr->player_active[next_player] ==0 && attempts < MXP) 
-                    {
-                        next_player = (next_player +1) % MXP;
-                        attempts = attempts +1;
-                    }
-                    
-                    gptr->CT = next_player;
-                    
-                    if (next_player ==0) 
-                    {
-                        gptr->round = gptr->round +1;
-                    }
+                    continue;
                 }
 
-                pthread_mutex_unlock(&gptr->shm_lock);
-
-                sprintf(buffer, "ROLLED %d", dice_value);
-                write(fd_write, buffer, strlen(buffer) + 1);
-                
-                char roll_log[256];
-                snprintf(roll_log, sizeof(roll_log), 
-                         "Player %s rolled %d! Position: R%d", 
-                         gptr->PN[player_id], 
-                         dice_value, 
-                         gptr->PP[player_id]);
-                log_message(roll_log);
-                printf("[Player-Handler] %s\n", roll_log);
-                
-                if (gptr->game_active == 0) 
+                if (fd_write == -1)
                 {
-                    break;
+                    fd_write = open(fifo_write_path, O_WRONLY);
                 }
+                reply.ts = mn();
+                fo(fd_write, &reply, 1);
+                rn(player_id, &reply, "[Player-Handler]");
             }
-        } 
-        else 
-        {
-            if (gptr->game_active == 0)
+                
+            if (gptr->game_active == 0) 
             {
                 break;
             }
-            usleep(50000);
+        } 
+        else if (bytes_read == 0)
+        {
+            // writer closed the FIFO, the client is gone so drop the slot and pass the turn on
+            dp(player_id);
+            break;
         }
     }
     
-    close(fd_read);
-    close(fd_write);
+    if (fd_read != -1)
+    {
+        close(fd_read);
+    }
+    if (client_fd != -1)
+    {
+        close(client_fd);
+    }
+    if (fd_write != -1 && fd_write != fd_read)
+    {
+        close(fd_write);
+    }
     
     char exit_log[256];
     snprintf(exit_log, sizeof(exit_log), 
              "[Player-Handler] Process %d for %s disconnecting", 
-             getpid(), gptr->PN[player_id]);
+             getpid(), pn(gptr)[player_id]);
     log_message(exit_log);
     
-    printf("[Player-Handler] Handler for %s exiting\n", gptr->PN[player_id]);
+    printf("[Player-Handler] Handler for %s exiting\n", pn(gptr)[player_id]);
 }
 
+// reap handlers and note each exit in the log ring, nothing here takes a lock
 void sigchld_handler(int sig)
 {
     int saved_error;
@@ -836,10 +2514,31 @@ void sigchld_handler(int sig)
         
         if (process_id >0) 
         {
-            char exit_message[128];
-            snprintf(exit_message, sizeof(exit_message), 
-                     "[SYSTEM] Player Process %d has exited", process_id);
-            log_message(exit_message);
+            // snprintf() is not async-signal-safe, the pid is spelled out by hand
+            const char head[] = "[SYSTEM] Player Process ";
+            const char tail[] = " has exited";
+            char exit_message[64];
+            char digits[16];
+            int d;
+            int k;
+            d = 0;
+            do
+            {
+                digits[d] = '0' + process_id % 10;
+                process_id = process_id / 10;
+                d = d + 1;
+            } while (process_id > 0);
+
+            memcpy(exit_message, head, sizeof(head) - 1);
+            k = sizeof(head) - 1;
+            while (d > 0)
+            {
+                d = d - 1;
+                exit_message[k] = digits[d];
+                k = k + 1;
+            }
+            memcpy(exit_message + k, tail, sizeof(tail));
+            lp(exit_message);
         } 
         else 
         {
@@ -850,20 +2549,92 @@ void sigchld_handler(int sig)
     errno = saved_error;
 }
 
+// only flags, futex wake-ups and write() in here, the interrupted thread may be holding any shm_lock
+// each table thread ends its own game in ge() once it wakes up and sees server_running
 void sigint_handler(int sig) 
 {
-    printf("\n\n[SYSTEM] Player hit Ctrl + C\n");
-    printf("[SYSTEM] Saving scores and shutting down...\n");
+    const char bye[] = "\n\n[SYSTEM] Player hit Ctrl + C\n[SYSTEM] Saving scores and shutting down...\n";
+    write(STDOUT_FILENO, bye, sizeof(bye) - 1);
     server_running = 0;
 
-    pthread_mutex_lock(&log_queue.mutex);
-    pthread_cond_signal(&log_queue.cond);
-    pthread_mutex_unlock(&log_queue.mutex);
-    
-    if (gptr != NULL) 
+    // the logger keeps draining until main wakes it after the tables finish
+    if (shm != NULL) 
     {
-        pthread_mutex_lock(&gptr->shm_lock);
-        gptr->game_active = 0;
-        pthread_mutex_unlock(&gptr->shm_lock);
+        shm->stopping = 1;
+
+        int t;
+        for (t = 0; t < table_count; t = t + 1)
+        {
+            wa(tp(shm, t));
+        }
+    }
+
+    // never read, so every handler polling the stop pipe keeps seeing it readable
+    write(stop_pipe[1], "x", 1);
+}
+
+// kill -USR1 <server pid> prints the turn latencies so far, the logger thread does the printing
+void sigusr1_handler(int sig)
+{
+    dump_req = 1;
+    if (shm != NULL)
+    {
+        fb(&shm->log_ring.ftx, 1);
+    }
+}
+
+void ld()
+{
+    const char *names[PHN] = { "roll sent->read", "read->locked", "locked->moved", "moved->turn",
+                               "turn->notified", "rolled->client", "notified->seen", "round trip" };
+
+    printf("\n[Latency] Turn phases since start, microseconds\n");
+    printf("[Latency] %-16s %10s %9s %9s %9s %9s %9s %9s\n",
+           "phase", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+
+    int i;
+    for (i = 0; i < PHN; i = i + 1)
+    {
+        struct Hist *h;
+        h = &shm->lat[i];
+
+        unsigned long long count;
+        count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+        if (count == 0)
+        {
+            printf("[Latency] %-16s %10d\n", names[i], 0);
+            continue;
+        }
+
+        printf("[Latency] %-16s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+               names[i], count,
+               (double)h->sum / count / 1000.0,
+               hp(h, 0.50) / 1000.0,
+               hp(h, 0.90) / 1000.0,
+               hp(h, 0.99) / 1000.0,
+               hp(h, 0.999) / 1000.0,
+               h->max / 1000.0);
+    }
+    fflush(stdout);
+}
+
+// lk = an uncontended lock costs one trylock, only a wait is timed
+void lk(struct GameInfo *g)
+{
+    mc(&g->counters.lock_taken, 1);
+    if (pthread_mutex_trylock(&g->shm_lock) == 0)
+    {
+        return;
     }
+
+    long long asked;
+    asked = mn();
+    pthread_mutex_lock(&g->shm_lock);
+    mc(&g->counters.lock_waits, 1);
+    mc(&g->counters.lock_wait_ns, mn() - asked);
+}
+
+void mc(unsigned long long *counter, long long n)
+{
+    __atomic_add_fetch(counter, (unsigned long long)n, __ATOMIC_RELAXED);
 }
\ No newline at end of file